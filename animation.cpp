@@ -0,0 +1,158 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+#include "animation.h"
+#include "history.h"
+#include "movetable.h"
+#include "patterns.h"
+#include <algorithm>
+
+MoveAnimator::MoveAnimator() {
+    backlogDepth = ANIMATION_BACKLOG;
+    speed = 4.0f;
+    progress = 0.0f;
+    serial = 0;
+    grouping = false;
+    groupSize = 1;
+    finishing = 0;
+}
+
+// Pieces with a sticker the move takes somewhere else
+static void movedPieces(int move, int config, uint64_t pieces[2]) {
+    const PieceLayout& layout = PieceLayout::get();
+    const uint8_t *permutation = MoveTable::get().getPermutation(move, config);
+    pieces[0] = pieces[1] = 0;
+    for (int i = 0; i < STICKER_COUNT; i++) {
+        if (permutation[i] != i) {
+            int piece = layout.slotPiece[i];
+            pieces[piece / 64] |= (uint64_t)1 << (piece % 64);
+        }
+    }
+}
+
+int MoveAnimator::findGroup(int config) {
+    if (!grouping || config == ILLEGAL_CONFIG) return 1;
+    const MoveTable& table = MoveTable::get();
+    int moves[MAX_ANIMATION_GROUP];
+    uint64_t used[2] = {0, 0};
+    int size = 0;
+    while (size < MAX_ANIMATION_GROUP && size < (int)pendingMoves.size()) {
+        const MoveEntry& entry = pendingMoves[size];
+        // Only turns the renderer puts on a single track, all taking as long
+        if (entry.type != TURN || (entry.cell != LEFT && entry.cell != RIGHT && entry.cell != IN && entry.cell != OUT)) break;
+        if (entry.animLength != pendingMoves.front().animLength) break;
+        int move = table.moveIndex(entry);
+        // Every turn is described from the configuration the group starts in
+        if (move < 0 || table.getNextConfig(move, config) != config) break;
+        bool commuting = true;
+        for (int i = 0; i < size && commuting; i++) {
+            commuting = table.commutes(moves[i], move);
+        }
+        uint64_t pieces[2];
+        movedPieces(move, config, pieces);
+        if (!commuting || (pieces[0] & used[0]) || (pieces[1] & used[1])) break;
+        used[0] |= pieces[0];
+        used[1] |= pieces[1];
+        moves[size++] = move;
+    }
+    return std::max(size, 1);
+}
+
+void MoveAnimator::scheduleMove(MoveEntry entry) {
+    // Moves can only cancel before any of them is shown
+    bool started = progress > 0.0f && (int)pendingMoves.size() <= groupSize;
+    if (!pendingMoves.empty() && !started && MoveHistory::isOpposite(pendingMoves.back(), entry)) {
+        pendingMoves.pop_back();
+        if (pendingMoves.empty()) serial++;
+        return;
+    }
+    if (pendingMoves.empty()) serial++;
+    pendingMoves.push_back(entry);
+}
+
+bool MoveAnimator::update(double dt, int config, MoveEntry *entry) {
+    if (pendingMoves.empty()) return false;
+    if (finishing == 0) {
+        if (progress == 0.0f) {
+            // Moves can still join until the group starts to show
+            int size = findGroup(config);
+            if (size != groupSize) serial++;
+            groupSize = size;
+        }
+        float scale = 1.0f;
+        if (backlogDepth > 0) {
+            int backlog = pendingMoves.size();
+            if (backlog > backlogDepth * MAX_BACKLOG_SPEEDUP) {
+                // Too far behind to catch up, the front group is finished without animating
+                progress = pendingMoves.front().animLength + 1.0f;
+            }
+            scale = std::min(std::max((float)backlog / backlogDepth, 1.0f), (float)MAX_BACKLOG_SPEEDUP);
+        }
+        progress += dt * speed * scale;
+        if (progress <= pendingMoves.front().animLength) return false;
+        finishing = groupSize;
+    }
+    *entry = pendingMoves.front();
+    pendingMoves.pop_front();
+    if (--finishing == 0) {
+        progress = 0.0f;
+        groupSize = 1;
+        serial++;
+    }
+    return true;
+}
+
+void MoveAnimator::clear() {
+    if (!pendingMoves.empty()) serial++;
+    pendingMoves.clear();
+    progress = 0.0f;
+    groupSize = 1;
+    finishing = 0;
+}
+
+void MoveAnimator::setGrouping(bool grouping) {
+    this->grouping = grouping;
+}
+
+bool MoveAnimator::isAnimating() {
+    return !pendingMoves.empty();
+}
+
+int MoveAnimator::getBacklogDepth() {
+    return backlogDepth;
+}
+
+void MoveAnimator::setBacklogDepth(int depth) {
+    backlogDepth = std::max(depth, 0);
+}
+
+int MoveAnimator::getGroupSize() {
+    return std::min(groupSize, (int)pendingMoves.size());
+}
+
+const MoveEntry& MoveAnimator::getMove(int index) {
+    return pendingMoves[index];
+}
+
+float MoveAnimator::getProgress() {
+    return progress;
+}
+
+uint64_t MoveAnimator::getSerial() {
+    return serial;
+}
@@ -0,0 +1,77 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <cstdint>
+#include <deque>
+#include "move.h"
+
+// Moves queued before animations speed up to keep the backlog this deep
+#define ANIMATION_BACKLOG 4
+// Animations run at most this many times faster, moves past
+// the deepest backlog they can catch up on are not animated at all
+#define MAX_BACKLOG_SPEEDUP 4
+// Most moves animated at once, each needs its own GPU animation track
+#define MAX_ANIMATION_GROUP 4
+
+// Moves waiting to be animated, advanced by the simulation step. Moves at the
+// front are only applied to the shown puzzle once their animation finishes.
+// With grouping on, cell turns at the front that commute and move none of the
+// same pieces animate together, the renderer composes them per piece
+class MoveAnimator {
+    public:
+        MoveAnimator();
+        // A move undoing the last waiting one cancels it instead of queueing
+        void scheduleMove(MoveEntry entry);
+        // True once the front move finishes, which is popped into entry. Call
+        // again with no time to collect the rest of its group and moves skipped
+        // over. config is the shown puzzle's, as PackedPuzzle::puzzleConfig
+        bool update(double dt, int config, MoveEntry *entry);
+        // Drops every waiting move, for when the puzzle is changed directly
+        void clear();
+        bool isAnimating();
+        // Only turns the renderer can draw on one track are grouped
+        void setGrouping(bool grouping);
+        // 0 never speeds up or skips
+        int getBacklogDepth();
+        void setBacklogDepth(int depth);
+        // Moves animating together at the front, at least 1 while animating
+        int getGroupSize();
+        const MoveEntry& getMove(int index);
+        float getProgress();
+        // Changes whenever different moves are at the front
+        uint64_t getSerial();
+
+    private:
+        std::deque<MoveEntry> pendingMoves;
+        int backlogDepth;
+        float speed;
+        float progress;
+        uint64_t serial;
+        bool grouping;
+        int groupSize;
+        // Moves of a finished group still to be popped
+        int finishing;
+
+        int findGroup(int config);
+};
+
+#endif // animation.h
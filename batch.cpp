@@ -0,0 +1,209 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+
+#include "batch.h"
+#include "movetable.h"
+#include <cstring>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+PuzzleBatch::PuzzleBatch(size_t count) {
+    this->count = count;
+    stride = (count + 31) / 32 * 32;
+    stickers.resize(STICKER_COUNT * stride);
+    configs.resize(stride);
+    illegal.resize(stride);
+    rowBuffer.resize(stride);
+    PackedPuzzle solved;
+    for (size_t i = 0; i < count; i++) {
+        set(i, solved);
+    }
+}
+
+size_t PuzzleBatch::size() const {
+    return count;
+}
+
+uint8_t* PuzzleBatch::row(int sticker) {
+    return &stickers[sticker * stride];
+}
+
+void PuzzleBatch::set(size_t index, const PackedPuzzle& state) {
+    for (int i = 0; i < STICKER_COUNT; i++) {
+        stickers[i * stride + index] = (uint8_t)state.getSticker(i);
+    }
+    configs[index] = state.getConfig();
+}
+
+PackedPuzzle PuzzleBatch::get(size_t index) const {
+    PackedPuzzle state;
+    for (int i = 0; i < STICKER_COUNT; i++) {
+        state.setSticker(i, (Color)stickers[i * stride + index]);
+    }
+    state.setConfig(configs[index]);
+    return state;
+}
+
+size_t PuzzleBatch::apply(const MoveEntry& entry) {
+    int move = MoveTable::get().moveIndex(entry);
+    if (move == -1) return 0;
+    return apply(move);
+}
+
+size_t PuzzleBatch::updateConfigs(int move) {
+    // Configuration transition is a 16 entry lookup, done as a byte shuffle
+    const MoveTable& table = MoveTable::get();
+    alignas(16) uint8_t lookup[CONFIG_COUNT];
+    for (int i = 0; i < CONFIG_COUNT; i++) {
+        lookup[i] = table.getNextConfig(move, i);
+    }
+
+    size_t i = 0;
+#if defined(__AVX2__)
+    __m256i lut = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)lookup));
+    __m256i none = _mm256_set1_epi8((char)ILLEGAL_CONFIG);
+    for (; i < stride; i += 32) {
+        __m256i config = _mm256_loadu_si256((const __m256i*)&configs[i]);
+        __m256i next = _mm256_shuffle_epi8(lut, config);
+        __m256i mask = _mm256_cmpeq_epi8(next, none);
+        _mm256_storeu_si256((__m256i*)&illegal[i], mask);
+        _mm256_storeu_si256((__m256i*)&configs[i], _mm256_blendv_epi8(next, config, mask));
+    }
+#elif defined(__SSSE3__)
+    __m128i lut = _mm_load_si128((const __m128i*)lookup);
+    __m128i none = _mm_set1_epi8((char)ILLEGAL_CONFIG);
+    for (; i < stride; i += 16) {
+        __m128i config = _mm_loadu_si128((const __m128i*)&configs[i]);
+        __m128i next = _mm_shuffle_epi8(lut, config);
+        __m128i mask = _mm_cmpeq_epi8(next, none);
+        _mm_storeu_si128((__m128i*)&illegal[i], mask);
+        __m128i result = _mm_or_si128(_mm_and_si128(mask, config), _mm_andnot_si128(mask, next));
+        _mm_storeu_si128((__m128i*)&configs[i], result);
+    }
+#elif defined(__wasm_simd128__)
+    v128_t lut = wasm_v128_load(lookup);
+    v128_t none = wasm_i8x16_splat((int8_t)ILLEGAL_CONFIG);
+    for (; i < stride; i += 16) {
+        v128_t config = wasm_v128_load(&configs[i]);
+        v128_t next = wasm_i8x16_swizzle(lut, config);
+        v128_t mask = wasm_i8x16_eq(next, none);
+        wasm_v128_store(&illegal[i], mask);
+        wasm_v128_store(&configs[i], wasm_v128_bitselect(config, next, mask));
+    }
+#endif
+    for (; i < stride; i++) {
+        uint8_t next = lookup[configs[i]];
+        illegal[i] = (next == ILLEGAL_CONFIG) ? 0xFF : 0;
+        if (next != ILLEGAL_CONFIG) configs[i] = next;
+    }
+
+    size_t moved = 0;
+    for (size_t j = 0; j < count; j++) {
+        moved += (illegal[j] == 0);
+    }
+    return moved;
+}
+
+void PuzzleBatch::moveRow(uint8_t *dest, const uint8_t *source, bool masked) {
+    if (!masked) {
+        std::memcpy(dest, source, stride);
+        return;
+    }
+    // dest = illegal ? dest : source
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i < stride; i += 32) {
+        __m256i mask = _mm256_loadu_si256((const __m256i*)&illegal[i]);
+        __m256i from = _mm256_loadu_si256((const __m256i*)&source[i]);
+        __m256i to = _mm256_loadu_si256((const __m256i*)&dest[i]);
+        _mm256_storeu_si256((__m256i*)&dest[i], _mm256_blendv_epi8(from, to, mask));
+    }
+#elif defined(__SSE2__)
+    for (; i < stride; i += 16) {
+        __m128i mask = _mm_loadu_si128((const __m128i*)&illegal[i]);
+        __m128i from = _mm_loadu_si128((const __m128i*)&source[i]);
+        __m128i to = _mm_loadu_si128((const __m128i*)&dest[i]);
+        _mm_storeu_si128((__m128i*)&dest[i], _mm_or_si128(_mm_and_si128(mask, to), _mm_andnot_si128(mask, from)));
+    }
+#elif defined(__wasm_simd128__)
+    for (; i < stride; i += 16) {
+        v128_t mask = wasm_v128_load(&illegal[i]);
+        wasm_v128_store(&dest[i], wasm_v128_bitselect(wasm_v128_load(&dest[i]), wasm_v128_load(&source[i]), mask));
+    }
+#endif
+    for (; i < stride; i++) {
+        dest[i] = illegal[i] ? dest[i] : source[i];
+    }
+}
+
+size_t PuzzleBatch::applyScalar(int move) {
+    // Configurations in the batch need different permutations, go state by state
+    const MoveTable& table = MoveTable::get();
+    size_t moved = 0;
+    for (size_t j = 0; j < count; j++) {
+        PackedPuzzle state = get(j);
+        if (table.apply(state, move)) {
+            set(j, state);
+            moved++;
+        }
+    }
+    return moved;
+}
+
+size_t PuzzleBatch::apply(int move) {
+    const MoveTable& table = MoveTable::get();
+    // Find the permutation shared by every legal configuration
+    const uint8_t *permutation = NULL;
+    bool shared = true;
+    for (int c = 0; c < CONFIG_COUNT; c++) {
+        if (table.getNextConfig(move, c) == ILLEGAL_CONFIG) continue;
+        const uint8_t *candidate = table.getPermutation(move, c);
+        if (permutation != NULL && permutation != candidate) shared = false;
+        permutation = candidate;
+    }
+    if (permutation == NULL) return 0;
+
+    if (!shared) return applyScalar(move);
+    size_t moved = updateConfigs(move);
+    if (moved == 0) return 0;
+
+    // Walk each cycle of the permutation, fixed stickers are never touched
+    bool masked = moved != count;
+    bool visited[STICKER_COUNT] = {};
+    for (int start = 0; start < STICKER_COUNT; start++) {
+        if (visited[start] || permutation[start] == start) continue;
+        std::memcpy(rowBuffer.data(), row(start), stride);
+        int current = start;
+        visited[current] = true;
+        while (permutation[current] != start) {
+            moveRow(row(current), row(permutation[current]), masked);
+            current = permutation[current];
+            visited[current] = true;
+        }
+        moveRow(row(current), rowBuffer.data(), masked);
+    }
+    return moved;
+}
@@ -0,0 +1,56 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "move.h"
+#include "packed.h"
+
+// Many puzzle states stored sticker-major, each row holds one sticker of every state
+class PuzzleBatch {
+    public:
+        explicit PuzzleBatch(size_t count);
+        size_t size() const;
+        void set(size_t index, const PackedPuzzle& state);
+        PackedPuzzle get(size_t index) const;
+        // States where the move is illegal are left unchanged, returns how many moved
+        size_t apply(const MoveEntry& entry);
+        size_t apply(int move);
+
+    private:
+        size_t count;
+        // Rows are padded to a multiple of 32 states for full vector loads
+        size_t stride;
+        std::vector<uint8_t> stickers;
+        std::vector<uint8_t> configs;
+        // 0 where the last move was legal, 0xFF where it was not
+        std::vector<uint8_t> illegal;
+        std::vector<uint8_t> rowBuffer;
+
+        uint8_t* row(int sticker);
+        size_t updateConfigs(int move);
+        void moveRow(uint8_t *dest, const uint8_t *source, bool masked);
+        size_t applyScalar(int move);
+};
+
+#endif // batch.h
@@ -0,0 +1,260 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+
+#include "batch.h"
+#include "movetable.h"
+#include "simulation.h"
+#include "solver.h"
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+
+// Every result is printed as "name value unit" for scripts to compare
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void report(const std::string& name, double value, const char *unit) {
+    // Whole numbers from 1000 up, at least four significant digits below
+    int decimals = 0;
+    for (double limit = 1000; value > 0 && value < limit && decimals < 6; limit /= 10) decimals++;
+    std::cout << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(decimals)
+              << std::setw(14) << value << " " << unit << std::endl;
+}
+
+static MoveEntry makeEntry(MoveType type, CellLocation cell, RotateDirection direction, int location) {
+    MoveEntry entry;
+    entry.type = type;
+    entry.animLength = 1.0f;
+    entry.cell = cell;
+    entry.direction = direction;
+    entry.location = location;
+    return entry;
+}
+
+// Repeats a cycle of moves, after the slice moves the first one needs
+static void benchMove(const char *name, std::vector<MoveEntry> cycle, size_t count) {
+    PuzzleSimulation simulation;
+    Puzzle& puzzle = *simulation.getPuzzle();
+    if (cycle[0].type == GYRO || cycle[0].type == TURN) {
+        std::vector<MoveEntry> moves = simulation.expandMove(cycle[0]);
+        for (size_t i = 0; i + 1 < moves.size(); i++) {
+            simulation.performMove(moves[i]);
+        }
+    }
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < count; i++) {
+        MoveTable::applyToPuzzle(puzzle, cycle[i % cycle.size()]);
+    }
+    report(std::string("move/") + name, count / seconds(start), "moves/s");
+}
+
+static void benchScramble(int length, size_t count) {
+    PuzzleSimulation simulation;
+    simulation.seed(1);
+    size_t characters = 0;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < count; i++) {
+        simulation.generateScramble(length);
+        characters += simulation.getHscScramble().size() + simulation.getPhysScramble().size();
+    }
+    double elapsed = seconds(start);
+    if (characters == 0) std::cout << "Empty scramble" << std::endl;
+    report("scramble/" + std::to_string(length), count / elapsed, "scrambles/s");
+
+    // Batch mode of scrambler, into buffers allocated once
+    std::vector<MoveEntry> moves(MAX_SCRAMBLE_MOVES(length));
+    std::vector<char> text(2 * MAX_FORMATTED_SCRAMBLE(moves.size()));
+    characters = 0;
+    start = Clock::now();
+    for (size_t i = 0; i < count; i++) {
+        size_t size = simulation.generateScramble(length, moves.data());
+        characters += PuzzleSimulation::formatHscScramble(moves.data(), size, text.data());
+        characters += PuzzleSimulation::formatPhysScramble(moves.data(), size, text.data() + text.size() / 2);
+    }
+    elapsed = seconds(start);
+    if (characters == 0) std::cout << "Empty scramble" << std::endl;
+    report("scramble-batch/" + std::to_string(length), count / elapsed, "scrambles/s");
+
+    start = Clock::now();
+    for (size_t i = 0; i < count; i++) {
+        simulation.reset();
+        simulation.applyMovesImmediate(simulation.generateScramble(length));
+    }
+    report("scramble-apply/" + std::to_string(length), count / seconds(start), "scrambles/s");
+}
+
+static void benchMoves(size_t count) {
+    benchMove("rotateCellX", {makeEntry(TURN, LEFT, ZY, 0)}, count);
+    benchMove("rotateCellY", {makeEntry(TURN, LEFT, XZ, 0)}, count);
+    benchMove("rotateCellZ", {makeEntry(TURN, LEFT, XY, 0)}, count);
+    benchMove("rotateSlice", {makeEntry(TURN, IN, ZY, 0)}, count);
+    benchMove("rotatePSliceCell", {makeEntry(TURN, UP, XZ, 0)}, count);
+    benchMove("gyroCellX", {makeEntry(GYRO, RIGHT, ZY, 0)}, count);
+    benchMove("gyroCellY", {makeEntry(GYRO, UP, ZY, 0)}, count);
+    benchMove("gyroCellZ", {makeEntry(GYRO, FRONT, ZY, 0)}, count);
+    benchMove("gyroOuterSlice", {makeEntry(GYRO_OUTER, IN, ZY, 0)}, count);
+    benchMove("gyroMiddleSlice", {makeEntry(GYRO_MIDDLE, IN, ZY, -1), makeEntry(GYRO_MIDDLE, IN, ZY, 1)}, count);
+    benchMove("gyroMiddleSliceDir", {makeEntry(GYRO_MIDDLE, IN, ZY, 0)}, count);
+    benchMove("rotatePuzzle", {makeEntry(ROTATE, IN, ZY, 0)}, count);
+}
+
+static void benchHint(int length) {
+    // Hints from a short scramble until it is solved or the search gives up. Hints
+    // that break up solved pieces can go on for a long time, so only the first few count
+    PuzzleSimulation simulation;
+    simulation.seed(1);
+    simulation.applyMovesImmediate(simulation.generateScramble(length));
+    Solver solver;
+    solver.setNodeLimit(HINT_NODE_LIMIT);
+    std::vector<MoveEntry> moves;
+    uint64_t nodes = 0;
+    int hints = 0;
+    Clock::time_point start = Clock::now();
+    while (hints < 20) {
+        bool found = solver.findHint(*simulation.getPuzzle(), HINT_DEPTH, moves);
+        nodes += solver.getNodeCount();
+        if (!found || moves.empty()) break;
+        hints++;
+        for (size_t i = 0; i < moves.size(); i++) {
+            simulation.performMove(moves[i]);
+        }
+    }
+    double elapsed = seconds(start);
+    // Time per hint reads better than a rate, as hints vary so much. Failing
+    // at the first hint counts as one hint taking the whole search
+    report("hint/" + std::to_string(length), 1000 * elapsed / std::max(hints, 1), "ms/hint");
+    report("hint-nodes/" + std::to_string(length), nodes / elapsed, "nodes/s");
+}
+
+static bool benchStateScramble(int depth, size_t count) {
+    PuzzleSimulation simulation;
+    simulation.seed(1);
+    Solver solver;
+    std::vector<std::vector<MoveEntry>> scrambles;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < count; i++) {
+        if (simulation.generateStateScramble(solver, depth)) scrambles.push_back(simulation.getScramble());
+    }
+    if (scrambles.size() != count) std::cout << "Solver gave up on " << count - scrambles.size() << " states" << std::endl;
+    report("scramble-state/" + std::to_string(depth), count / seconds(start), "scrambles/s");
+
+    // Applied directly and loaded from a log, each scramble reaches what its physical moves do
+    const char *filename = "bench-scramble.yaml";
+    for (size_t i = 0; i < scrambles.size(); i++) {
+        Puzzle puzzle;
+        for (size_t j = 0; j < scrambles[i].size(); j++) {
+            MoveTable::applyToPuzzle(puzzle, scrambles[i][j]);
+        }
+        PackedPuzzle expected(puzzle);
+        PuzzleSimulation applied;
+        applied.applyMovesImmediate(scrambles[i]);
+
+        std::string text(MAX_FORMATTED_SCRAMBLE(scrambles[i].size()), ' ');
+        text.resize(PuzzleSimulation::formatPhysScramble(scrambles[i].data(), scrambles[i].size(), &text[0]));
+        std::ofstream(filename) << "phys_scramble: >\n  " << text << "\n";
+        PuzzleSimulation loaded;
+        std::string error;
+        bool read = loaded.loadLog(filename, error);
+        std::remove(filename);
+        if (PackedPuzzle(*applied.getPuzzle()) != expected || !read || PackedPuzzle(*loaded.getPuzzle()) != expected) {
+            std::cout << "State scramble " << i << " does not match Puzzle" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    size_t states = (argc > 1) ? std::atoi(argv[1]) : 4096;
+    size_t length = (argc > 2) ? std::atoi(argv[2]) : 200;
+    const MoveTable& table = MoveTable::get();
+    if (!PuzzleSimulation::verifyGyroExpansions()) {
+        std::cout << "Gyro expansion table does not match Puzzle" << std::endl;
+        return 1;
+    }
+    if (!table.verify(10000, 1)) {
+        std::cout << "Move table does not match Puzzle" << std::endl;
+        return 1;
+    }
+
+    benchMoves(100000);
+    int scrambleLengths[] = {10, 45, 100, 1000};
+    for (int scrambleLength : scrambleLengths) {
+        benchScramble(scrambleLength, 100000 / scrambleLength);
+    }
+    benchHint(3);
+    benchHint(5);
+    if (!benchStateScramble(4, 20)) return 1;
+
+    // Random legal sequence, legal for every state since they all start solved
+    std::mt19937 generator(1);
+    std::uniform_int_distribution<int> distribution(0, MOVE_COUNT - 1);
+    std::vector<MoveEntry> sequence;
+    Puzzle walk;
+    while (sequence.size() < length) {
+        const MoveEntry& entry = table.moveEntry(distribution(generator));
+        if (!MoveTable::canApply(walk, entry)) continue;
+        MoveTable::applyToPuzzle(walk, entry);
+        sequence.push_back(entry);
+    }
+
+    std::vector<Puzzle> puzzles(states);
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < sequence.size(); i++) {
+        for (size_t j = 0; j < states; j++) {
+            MoveTable::applyToPuzzle(puzzles[j], sequence[i]);
+        }
+    }
+    report("batch/puzzle", states * length / seconds(start), "state-moves/s");
+
+    std::vector<PackedPuzzle> packed(states);
+    start = Clock::now();
+    for (size_t i = 0; i < sequence.size(); i++) {
+        int move = table.moveIndex(sequence[i]);
+        for (size_t j = 0; j < states; j++) {
+            table.apply(packed[j], move);
+        }
+    }
+    report("batch/packed", states * length / seconds(start), "state-moves/s");
+
+    PuzzleBatch batch(states);
+    start = Clock::now();
+    for (size_t i = 0; i < sequence.size(); i++) {
+        batch.apply(sequence[i]);
+    }
+    report("batch/batch", states * length / seconds(start), "state-moves/s");
+
+    for (size_t j = 0; j < states; j++) {
+        PackedPuzzle expected(puzzles[j]);
+        if (packed[j] != expected || batch.get(j) != expected) {
+            std::cout << "State " << j << " does not match Puzzle" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
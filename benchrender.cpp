@@ -0,0 +1,181 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+#include <glad/gl.h>
+#include <linmath.h>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include "camera.h"
+#include "render.h"
+#include "simulation.h"
+#include "shaders.h"
+#include "constants.h"
+
+// Frame times of renderPuzzle in a hidden window, printed as "name value unit"
+
+#define WIDTH 960
+#define HEIGHT 540
+#define FRAMES 300
+
+typedef std::chrono::steady_clock Clock;
+
+struct RenderCase {
+    const char *name;
+    MoveType type;
+    CellLocation cell;
+    RotateDirection direction;
+    int location;
+    bool animated;
+};
+
+static const RenderCase cases[] = {
+    {"static", TURN, LEFT, ZY, 0, false},
+    {"turn-left", TURN, LEFT, ZY, 0, true},
+    {"turn-right", TURN, RIGHT, XZ, 0, true},
+    {"turn-in", TURN, IN, ZY, 0, true},
+    {"turn-out", TURN, OUT, YZ, 0, true},
+    {"turn-up", TURN, UP, XZ, 0, true},
+    {"turn-front", TURN, FRONT, XY, 0, true},
+    {"rotate", ROTATE, IN, ZY, 0, true},
+    {"gyro-x", GYRO, RIGHT, ZY, 0, true},
+    {"gyro-y", GYRO, UP, ZY, 0, true},
+    {"gyro-z", GYRO, FRONT, ZY, 0, true},
+    {"gyro-outer", GYRO_OUTER, IN, ZY, 0, true},
+    {"gyro-middle", GYRO_MIDDLE, IN, ZY, -1, true},
+    {"gyro-middle-dir", GYRO_MIDDLE, IN, ZY, 0, true},
+};
+
+static double benchCase(Shader *shader, Camera& camera, Puzzle *puzzle, const RenderCase& renderCase, bool instancing) {
+    PuzzleRenderer renderer(puzzle);
+    renderer.setCamera(*camera.getViewMat(), *camera.getProjection());
+    PuzzleSimulation simulation(puzzle);
+    renderer.setInstancing(instancing);
+
+    MoveEntry entry;
+    entry.type = renderCase.type;
+    entry.animLength = 1.0f;
+    entry.cell = renderCase.cell;
+    entry.direction = renderCase.direction;
+    entry.location = renderCase.location;
+    if (entry.type == GYRO || entry.type == TURN) {
+        // Slice moves the configuration needs, made without animating
+        std::vector<MoveEntry> moves = simulation.expandMove(entry);
+        for (size_t i = 0; i + 1 < moves.size(); i++) {
+            simulation.performMove(moves[i]);
+        }
+        entry = moves.back();
+    }
+    // Stopped partway through, later frames do not advance
+    PuzzleSnapshot frame;
+    frame.puzzle = *puzzle;
+    frame.stateVersion = 1;
+    frame.animating = renderCase.animated;
+    frame.moves[0] = entry;
+    frame.moveCount = 1;
+    frame.progress = 0.4f;
+    renderer.setFrame(frame);
+
+    // One untimed frame for buffer uploads and shader warmup
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    renderer.renderPuzzle(shader);
+    glFinish();
+
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < FRAMES; i++) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        renderer.renderPuzzle(shader);
+        glFinish();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    puzzle->resetPuzzle();
+    return FRAMES / elapsed;
+}
+
+int main() {
+    if (!glfwInit()) {
+        std::cerr << "Skipping render benchmarks, failed to init GLFW" << std::endl;
+        return 0;
+    }
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    GLFWwindow *window = glfwCreateWindow(WIDTH, HEIGHT, "3to4++ bench", NULL, NULL);
+    if (!window) {
+        std::cerr << "Skipping render benchmarks, failed to create window" << std::endl;
+        glfwTerminate();
+        return 0;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGL(glfwGetProcAddress)) {
+        std::cerr << "Skipping render benchmarks, failed to load GL" << std::endl;
+        glfwTerminate();
+        return 0;
+    }
+    glfwSwapInterval(0);
+
+    // Hidden windows may have no usable default framebuffer
+    unsigned int fbo, colorBuffer, depthBuffer;
+    glGenFramebuffers(1, &fbo);
+    glGenRenderbuffers(1, &colorBuffer);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, WIDTH, HEIGHT);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, WIDTH, HEIGHT);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    glViewport(0, 0, WIDTH, HEIGHT);
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+    glDepthMask(GL_TRUE);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(1.0, 1.0);
+    glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
+
+    Shader *shader = new Shader(Shaders::modelVertex, Shaders::modelFragment);
+    Camera camera(M_PI_4, WIDTH, HEIGHT, 0.02, 50);
+    camera.setPitch(M_PI / 180 * -20);
+    camera.setYaw(M_PI / 180 * -20);
+    Puzzle puzzle;
+    for (const RenderCase& renderCase : cases) {
+        for (int instancing = 0; instancing < 2; instancing++) {
+            std::string name = std::string("render/") + renderCase.name + (instancing ? "/instanced" : "/immediate");
+            double fps = benchCase(shader, camera, &puzzle, renderCase, instancing);
+            std::cout << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(0)
+                      << std::setw(14) << fps << " frames/s" << std::endl;
+        }
+    }
+
+    delete shader;
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    glDeleteRenderbuffers(1, &depthBuffer);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
@@ -20,6 +20,7 @@
 #include <GLFW/glfw3.h>
 #include <linmath.h>
 #include <cmath>
+#include <algorithm>
 #include "constants.h"
 #include "camera.h"
 
@@ -56,6 +57,29 @@ mat4x4* Camera::getProjection() {
     return &projection;
 }
 
+void Camera::getCursorRay(GLFWwindow* window, vec3 origin, vec3 direction) {
+    double cursorX, cursorY;
+    int windowWidth, windowHeight;
+    glfwGetCursorPos(window, &cursorX, &cursorY);
+    glfwGetWindowSize(window, &windowWidth, &windowHeight);
+    float x = 2.0f * cursorX / std::max(windowWidth, 1) - 1.0f;
+    float y = 1.0f - 2.0f * cursorY / std::max(windowHeight, 1);
+
+    mat4x4 viewProjection, inverse;
+    mat4x4_mul(viewProjection, projection, *getViewMat());
+    mat4x4_invert(inverse, viewProjection);
+    // Unproject the cursor on the near and far planes
+    vec4 clipNear = {x, y, -1.0f, 1.0f}, clipFar = {x, y, 1.0f, 1.0f};
+    vec4 worldNear, worldFar;
+    mat4x4_mul_vec4(worldNear, inverse, clipNear);
+    mat4x4_mul_vec4(worldFar, inverse, clipFar);
+    for (int i = 0; i < 3; i++) {
+        origin[i] = worldNear[i] / worldNear[3];
+        direction[i] = worldFar[i] / worldFar[3] - origin[i];
+    }
+    vec3_norm(direction, direction);
+}
+
 void Camera::calcViewMat() {
     mat4x4_identity(view);
     mat4x4_translate_in_place(view, 0, 0, -zoom);
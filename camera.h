@@ -35,6 +35,8 @@ class Camera {
         bool inputFlipped();
         mat4x4* getViewMat();
         mat4x4* getProjection();
+        // World space ray through the cursor, direction is normalised
+        void getCursorRay(GLFWwindow* window, vec3 origin, vec3 direction);
 
         void scrollCallback(GLFWwindow* window, double xoffset, double yoffset);
         void framebufferSizeCallback(GLFWwindow* window, int width, int height);
@@ -19,15 +19,9 @@
 
 #include "control.h"
 #include "constants.h"
-#include <algorithm>
-#include <array>
-#include <random>
-#include <map>
 #include <sstream>
-#include <fstream>
+#include <chrono>
 #include <iostream>
-#define RYML_SINGLE_HDR_DEFINE_NOW
-#include <rapidyaml-0.6.0.hpp>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -58,78 +52,173 @@ int PuzzleController::cellKeys[] = {GLFW_KEY_D, GLFW_KEY_V, GLFW_KEY_F, GLFW_KEY
 int PuzzleController::directionKeys[] = {GLFW_KEY_I, GLFW_KEY_K, GLFW_KEY_J,
                                          GLFW_KEY_L, GLFW_KEY_O, GLFW_KEY_U};
 
-PuzzleController::PuzzleController(PuzzleRenderer* renderer) {
+PuzzleController::PuzzleController(Puzzle* puzzle, PuzzleRenderer* renderer) {
 	this->renderer = renderer;
-	this->puzzle = renderer->puzzle;
-    history = new MoveHistory();
-    std::random_device rd;
-    rng.seed(rd());
-    scrambleIndex = -1;
-
-    std::ifstream file("scramble.txt");
-    if (!file.fail()) {
-        file >> std::ws;
-        std::vector<std::array<int, 2>> moves;
-        std::array<int, 2> move;
-        char comma;
-        while (true) {
-            file >> move[0] >> comma >> move[1];
-            if (file.eof()) {
-                break;
-            }
-            if (comma == ',') {
-                moves.push_back(move);
-            }
-        }
-        for (size_t i = 0; i < moves.size(); i++) {
-            CellLocation cell = (CellLocation)moves[i][0];
-            if (moves[i][1] == -1) {
-                startGyro(cell);
+	this->puzzle = puzzle;
+    simulation = new PuzzleSimulation(puzzle);
+    history = simulation->getHistory();
+    solver = new Solver();
+    solver->setNodeLimit(HINT_NODE_LIMIT);
+    // Optional, written by make patterns
+    solver->loadPatterns("patterns.pdb");
+    timerArmed = false;
+    timerRunning = false;
+    solveTime = -1.0;
+    stateVersion = 1;
+    changes = 1;
+    postedChanges = 0;
+    wakePending = false;
+    stopping = false;
+    hoverCell = -1;
+    selectedCell = -1;
+    hintSearching = false;
+    hintReady = false;
+    hintFound = false;
+
+    if (simulation->loadScramble("scramble.txt")) {
+        getScrambleTwists();
+        armTimer();
+    }
+    shownPuzzle = *puzzle;
+    animator.setGrouping(renderer->getInstancing());
+    publishSnapshot();
+#ifndef __EMSCRIPTEN__
+    simulationThread = std::thread(&PuzzleController::simulationLoop, this);
+#endif
+}
+
+PuzzleController::~PuzzleController() {
+#ifndef __EMSCRIPTEN__
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    simulationThread.join();
+    if (hintThread.joinable()) hintThread.join();
+#endif
+    delete solver;
+    delete simulation;
+}
+
+#ifndef __EMSCRIPTEN__
+void PuzzleController::simulationLoop() {
+    double lastStep = glfwGetTime();
+    bool animating = false;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            if (animating) {
+                wake.wait_for(lock, std::chrono::duration<double>(SIMULATION_STEP), [this]() {return stopping;});
             } else {
-                startCellMove(cell, (RotateDirection)moves[i][1]);
-            }
-            while (renderer->pendingMoves.size()) {
-                MoveEntry entry = renderer->pendingMoves.front();
-                renderer->pendingMoves.pop();
-                performMove(entry);
-                scramble.push_back(entry);
+                wake.wait(lock, [this]() {return stopping || wakePending;});
+                // Time spent idle is not animation time
+                lastStep = glfwGetTime();
             }
+            if (stopping) return;
+            wakePending = false;
         }
-        renderer->animating = false;
-        getScrambleTwists();
+        std::lock_guard<std::mutex> lock(stateMutex);
+        double now = glfwGetTime();
+        stepSimulation(now - lastStep);
+        lastStep = now;
+        animating = animator.isAnimating();
     }
 }
+#endif
 
-PuzzleController::~PuzzleController() {
-    delete this->history;
+void PuzzleController::stepSimulation(double dt) {
+    updatePuzzle(dt);
+    InputEvent event;
+    while (inputQueue.pop(event)) {
+        handleKey(event);
+        changes++;
+    }
+    if (finishHint()) changes++;
+    publishSnapshot();
 }
 
-void PuzzleController::performMove(MoveEntry entry) {
-    switch (entry.type) {
-        case TURN: puzzle->rotateCell(entry.cell, entry.direction); break;
-        case ROTATE: puzzle->rotatePuzzle(entry.direction); break;
-        case GYRO: puzzle->gyroCell(entry.cell); break;
-        case GYRO_OUTER: puzzle->gyroOuterSlice(); break;
-        case GYRO_MIDDLE: puzzle->gyroMiddleSlice(entry.location); break;
+void PuzzleController::publishSnapshot() {
+    PuzzleSnapshot& snapshot = snapshots.back();
+    // The shown puzzle only changes between animations, most steps skip the copy
+    if (snapshot.stateVersion != stateVersion) {
+        snapshot.puzzle = shownPuzzle;
+        snapshot.stateVersion = stateVersion;
+    }
+    snapshot.changes = changes;
+    snapshot.animating = animator.isAnimating();
+    snapshot.moveCount = 0;
+    if (snapshot.animating) {
+        snapshot.moveCount = animator.getGroupSize();
+        for (int i = 0; i < snapshot.moveCount; i++) {
+            snapshot.moves[i] = animator.getMove(i);
+        }
+        snapshot.progress = animator.getProgress();
+    }
+    snapshot.moveSerial = animator.getSerial();
+    snapshot.timerRunning = timerRunning;
+    snapshots.publish();
+#ifndef __EMSCRIPTEN__
+    if (postedChanges != changes) {
+        // The main loop may be asleep waiting for events
+        postedChanges = changes;
+        glfwPostEmptyEvent();
+    }
+#endif
+}
+
+bool PuzzleController::readSnapshot(PuzzleSnapshot& frame) {
+    return snapshots.read(frame);
+}
+
+std::mutex& PuzzleController::getStateMutex() {
+    return stateMutex;
+}
+
+void PuzzleController::wakeSimulation() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wakePending = true;
     }
+    wake.notify_one();
+}
+
+void PuzzleController::markStateChanged() {
+    // Nothing left to animate towards, the change is shown as it is
+    animator.clear();
+    shownPuzzle = *puzzle;
+    stateVersion++;
+    changes++;
+    wakeSimulation();
 }
 
-bool PuzzleController::updatePuzzle(GLFWwindow *window, double dt) {
+void PuzzleController::performMove(MoveEntry entry) {
+    simulation->performMove(entry);
+    history->insertMove(entry);
+}
+
+bool PuzzleController::updatePuzzle(double dt) {
 	MoveEntry entry;
     bool updated = false;
-	if (renderer->updateAnimations(window, dt, &entry)) {
-        performMove(entry);
-        if (scrambleIndex != -1) {
-            if (renderer->pendingMoves.size() == 0) {
-                scrambleIndex++;
-                performScramble();
-            }
-        } else {
-            history->insertMove(entry);
+	while (animator.update(dt, PackedPuzzle::puzzleConfig(shownPuzzle), &entry)) {
+        MoveTable::applyToPuzzle(shownPuzzle, entry);
+        stateVersion++;
+        changes++;
+        // The rest of a group and skipped moves come out after the first, with no time of their own
+        dt = 0.0;
+        if (timerArmed && !timerRunning) {
+            timerRunning = true;
+            timerStart = glfwGetTime();
+        }
+        if (timerRunning && shownPuzzle.isSolved()) {
+            timerRunning = false;
+            timerArmed = false;
+            solveTime = glfwGetTime() - timerStart;
+            status = "Solved!";
         }
         updated = true;
 	}
-    return updated || renderer->animating;
+    return updated;
 }
 
 bool PuzzleController::checkMiddleGyro(int key, bool flip) {
@@ -141,7 +230,7 @@ bool PuzzleController::checkMiddleGyro(int key, bool flip) {
             entry.type = GYRO_MIDDLE;
             entry.animLength = 1.0f;
             entry.location = direction;
-            renderer->scheduleMove(entry);
+            scheduleMove(entry);
             return true;
         }
     } else if (key == GLFW_KEY_COMMA) {
@@ -149,23 +238,34 @@ bool PuzzleController::checkMiddleGyro(int key, bool flip) {
         entry.type = GYRO_MIDDLE;
         entry.animLength = 1.0f;
         entry.location = 0;
-        renderer->scheduleMove(entry);
+        scheduleMove(entry);
         return true;
     }
     return false;
 }
 
-bool PuzzleController::checkCellKeys(GLFWwindow* window, CellLocation* cell, bool flip) {
+unsigned int PuzzleController::getHeldCells(GLFWwindow* window) {
+    unsigned int heldCells = 0;
+    for (int i = 0; i < 8; i++) {
+        if (glfwGetKey(window, cellKeys[i])) heldCells |= 1u << i;
+    }
+    return heldCells;
+}
+
+int PuzzleController::flipCell(int cell, bool flip) {
+    if (flip && cell != 0 && cell != 1 && cell != 4 && cell != 5) {
+        // Do not flip IN, OUT, UP, DOWN
+        return cell / 2 * 2 + 1 - cell % 2;
+    }
+    return cell;
+}
+
+bool PuzzleController::checkCellKeys(unsigned int heldCells, CellLocation* cell, bool flip) {
     bool foundCell = false;
     for (int i = 0; i < 8; i++) {
-        if (glfwGetKey(window, cellKeys[i])) {
+        if (heldCells & (1u << i)) {
             foundCell = true;
-            if (flip && i != 0 && i != 1 && i != 4 && i != 5) {
-                // Do not flip IN, OUT, UP, DOWN
-                *cell = (CellLocation)(i / 2 * 2 + 1 - i % 2);
-            } else {
-                *cell = (CellLocation)i;
-            }
+            *cell = (CellLocation)flipCell(i, flip);
         }
     }
     return foundCell;
@@ -188,10 +288,10 @@ bool PuzzleController::checkDirectionKey(int key, RotateDirection* direction, bo
     return foundDirection;
 }
 
-bool PuzzleController::checkDirectionalMove(GLFWwindow* window, int key, bool flip) {
+bool PuzzleController::checkDirectionalMove(unsigned int heldCells, int key, bool flip) {
     CellLocation cell;
     RotateDirection direction;
-    if (checkCellKeys(window, &cell, flip)) {
+    if (checkCellKeys(heldCells, &cell, flip)) {
         if (key == GLFW_KEY_SPACE) {
             startGyro(cell);
             return true;
@@ -210,7 +310,7 @@ bool PuzzleController::checkDirectionalMove(GLFWwindow* window, int key, bool fl
             entry.type = ROTATE;
             entry.animLength = 1.0f;
             entry.direction = direction;
-            renderer->scheduleMove(entry);
+            scheduleMove(entry);
             return true;
         }
     }
@@ -218,155 +318,73 @@ bool PuzzleController::checkDirectionalMove(GLFWwindow* window, int key, bool fl
 }
 
 void PuzzleController::startGyro(CellLocation cell) {
-    MoveEntry entry;
-    int direction = 0;
-    switch (cell) {
-        case LEFT:
-        case RIGHT:
-            entry.type = GYRO;
-            entry.animLength = 4.0f;
-            entry.cell = cell;
-            renderer->scheduleMove(entry);
-            break;
-        case UP:
-        case DOWN:
-            if (puzzle->middleSliceDir == FRONT) {
-                entry.type = GYRO_MIDDLE;
-                entry.animLength = 1.0f;
-                entry.location = 0;
-                renderer->scheduleMove(entry);
-            }
-
-            if (puzzle->middleSlicePos == 0) {
-                direction = puzzle->outerSlicePos;
-            } else if (puzzle->middleSlicePos == 2 * puzzle->outerSlicePos) {
-                direction = -puzzle->outerSlicePos;
-            } else if (puzzle->middleSlicePos == -puzzle->outerSlicePos) {
-                entry.type = GYRO_OUTER;
-                entry.animLength = 2.0f;
-                entry.location = -1 * puzzle->outerSlicePos;
-                renderer->scheduleMove(entry);
-                direction = 0;
-            } else if (puzzle->middleSlicePos == puzzle->outerSlicePos) {
-                direction = 0;
-            }
-
-            if (direction != 0) {
-                entry.type = GYRO_MIDDLE;
-                entry.animLength = 1.0f;
-                entry.location = direction;
-                renderer->scheduleMove(entry);
-            }
-
-            entry.type = GYRO;
-            entry.animLength = 3.0f;
-            entry.cell = cell;
-            renderer->scheduleMove(entry);
-            break;
-        case FRONT:
-        case BACK:
-            if (puzzle->middleSliceDir == UP) {
-                entry.type = GYRO_MIDDLE;
-                entry.animLength = 1.0f;
-                entry.location = 0;
-                renderer->scheduleMove(entry);
-            }
-
-            if (puzzle->middleSlicePos == 0) {
-                direction = puzzle->outerSlicePos;
-            } else if (puzzle->middleSlicePos == 2 * puzzle->outerSlicePos) {
-                direction = -puzzle->outerSlicePos;
-            } else if (puzzle->middleSlicePos == -puzzle->outerSlicePos) {
-                entry.type = GYRO_OUTER;
-                entry.animLength = 2.0f;
-                entry.location = -1 * puzzle->outerSlicePos;
-                renderer->scheduleMove(entry);
-                direction = 0;
-            } else if (puzzle->middleSlicePos == puzzle->outerSlicePos) {
-                direction = 0;
-            }
-
-            if (direction != 0) {
-                entry.type = GYRO_MIDDLE;
-                entry.animLength = 1.0f;
-                entry.location = direction;
-                renderer->scheduleMove(entry);
-            }
-
-            entry.type = GYRO;
-            entry.animLength = 3.0f;
-            entry.cell = cell;
-            renderer->scheduleMove(entry);
-            break;
-        case IN:
-        case OUT:
-            return;
-    }
+    scheduleMoves(simulation->expandGyro(cell));
 }
 
 void PuzzleController::startCellMove(CellLocation cell, RotateDirection direction) {
-    MoveEntry entry;
-    if ((cell == UP || cell == DOWN) && puzzle->middleSliceDir == FRONT) {
-        entry.type = GYRO_MIDDLE;
-        entry.animLength = 1.0f;
-        entry.location = 0;
-        renderer->scheduleMove(entry);
-    } else if ((cell == FRONT || cell == BACK) && puzzle->middleSliceDir == UP) {
-        entry.type = GYRO_MIDDLE;
-        entry.animLength = 1.0f;
-        entry.location = 0;
-        renderer->scheduleMove(entry);
-    }
+    scheduleMoves(simulation->expandCellMove(cell, direction));
+}
 
-    float length;
-    if (cell == UP || cell == DOWN || cell == FRONT || cell == BACK) {
-        length = 2.0f;
-    } else {
-        length = 1.0f;
-    }
+void PuzzleController::scheduleMove(MoveEntry entry) {
+    // Later presses are checked against the puzzle with every queued move made
+    performMove(entry);
+    animator.scheduleMove(entry);
+    changes++;
+    wakeSimulation();
+}
 
-    entry.type = TURN;
-    entry.animLength = length;
-    entry.cell = cell;
-    entry.direction = direction;
-    renderer->scheduleMove(entry);
+void PuzzleController::scheduleMoves(const std::vector<MoveEntry>& moves) {
+    for (size_t i = 0; i < moves.size(); i++) {
+        scheduleMove(moves[i]);
+    }
 }
 
 void PuzzleController::keyCallback(GLFWwindow* window, int key, int action, int mods, bool flip) {
-    if (renderer->animating) return;
-    if (action == GLFW_PRESS) {
-        status.clear();
-        if (mods == 0) {
-            if (checkMiddleGyro(key, flip)) return;
-            if (checkDirectionalMove(window, key, flip)) return;
-
-            if (key == GLFW_KEY_SPACE) {
-                // gyro outer layer
-                MoveEntry entry;
-                entry.type = GYRO_OUTER;
-                entry.animLength = 2.0f;
-                entry.location = -1 * puzzle->outerSlicePos;
-                renderer->scheduleMove(entry);
-            } else if (key == GLFW_KEY_Z) {
-                undoMove();
-            } else if (key == GLFW_KEY_Y) {
-                redoMove();
-            }
-        }
+    // Shortcuts with modifiers belong to the GUI
+    if (action != GLFW_PRESS || mods != 0) return;
+    InputEvent event;
+    event.key = key;
+    event.flip = flip;
+    // Read now, the keys may be let go before the press is handled
+    event.heldCells = getHeldCells(window);
+    if (selectedCell != -1) event.heldCells |= 1u << flipCell(selectedCell, flip);
+    if (inputQueue.push(event)) wakeSimulation();
+}
+
+void PuzzleController::handleKey(const InputEvent& event) {
+    int key = event.key;
+    bool flip = event.flip;
+    status.clear();
+    if (checkMiddleGyro(key, flip)) return;
+    if (checkDirectionalMove(event.heldCells, key, flip)) return;
+
+    if (key == GLFW_KEY_SPACE) {
+        // gyro outer layer
+        MoveEntry entry;
+        entry.type = GYRO_OUTER;
+        entry.animLength = 2.0f;
+        entry.location = -1 * puzzle->outerSlicePos;
+        scheduleMove(entry);
+    } else if (key == GLFW_KEY_Z) {
+        undoMove();
+    } else if (key == GLFW_KEY_Y) {
+        redoMove();
     }
 }
 
 void PuzzleController::resetPuzzle() {
-    puzzle->resetPuzzle();
-    scramble.clear();
-    history->reset();
+    simulation->reset();
+    markStateChanged();
+    timerArmed = false;
+    timerRunning = false;
+    solveTime = -1.0;
     status = "Reset puzzle!";
 }
 
 void PuzzleController::undoMove() {
     MoveEntry entry;
     if (history->undoMove(&entry)) {
-        renderer->scheduleMove(entry);
+        scheduleMove(entry);
         status = "Undid 1 move!";
     } else {
         status = "Error: nothing to undo!";
@@ -376,333 +394,197 @@ void PuzzleController::undoMove() {
 void PuzzleController::redoMove() {
     MoveEntry entry;
     if (history->redoMove(&entry)) {
-        renderer->scheduleMove(entry);
+        scheduleMove(entry);
         status = "Redid 1 move!";
     } else {
         status = "Error: nothing to redo!";
     }
 }
 
-void rotate4in8(std::array<int, 8>& cells, std::array<int, 4> indices) {
-    int temp = cells[indices[0]];
-    for (int i = 0; i < 3; i++) {
-        cells[indices[i]] = cells[indices[i + 1]];
-    }
-    cells[indices[3]] = temp;
-}
-
-void rotate8bycell(std::array<int, 8>& cells, CellLocation cell) {
-    if (cell == RIGHT) {
-        rotate4in8(cells, {0, 6, 1, 7});
-    } else if (cell == LEFT) {
-        rotate4in8(cells, {1, 6, 0, 7});
-    } else if (cell == UP) {
-        rotate4in8(cells, {2, 6, 3, 7});
-    } else if (cell == DOWN) {
-        rotate4in8(cells, {3, 6, 2, 7});
-    } else if (cell == FRONT) {
-        rotate4in8(cells, {4, 6, 5, 7});
-    } else if (cell == BACK) {
-        rotate4in8(cells, {5, 6, 4, 7});
+void PuzzleController::showHint() {
+    if (hintSearching) {
+        status = "Error: still searching for a hint!";
+        return;
     }
+    hintSearching = true;
+    hintStart = *puzzle;
+    status = "Searching for a hint...";
+#ifdef __EMSCRIPTEN__
+    // No threads in the browser, HINT_NODE_LIMIT keeps this short
+    searchHint(hintStart);
+#else
+    if (hintThread.joinable()) hintThread.join();
+    hintThread = std::thread(&PuzzleController::searchHint, this, hintStart);
+#endif
 }
 
-void PuzzleController::scramblePuzzle(int scrambleLength) {
-    static std::discrete_distribution<int> typeDist({2, 3});
-    static std::uniform_int_distribution<int> directionDist(0, 5);
-    static std::discrete_distribution<int> cellDist({2, 2, 6, 6, 1, 1, 1, 1});
-    // FBUD only for visual effect, functionally unneeded
-    static std::uniform_int_distribution<int> boolDist(0, 1);
-    MoveEntry entry;
-    entry.type = TURN;
-    if (scrambleLength == 0) {
-        scrambleLength = 45;
+void PuzzleController::searchHint(Puzzle start) {
+    std::vector<MoveEntry> moves;
+    bool found = solver->findHint(start, HINT_DEPTH, moves);
+    {
+        std::lock_guard<std::mutex> lock(hintMutex);
+        hintFound = found;
+        hintMoves = moves;
+        hintReady = true;
     }
-    CellLocation lastCell = (CellLocation)-1;
-    for (int i = 0; i < scrambleLength; i++) {
-        if (typeDist(rng) == 0 && entry.type != GYRO) {
-            // don't include gyros in scramble length
-            i--;
-            entry.type = GYRO;
-            entry.cell = (CellLocation)(2 + directionDist(rng));
-        } else {
-            entry.type = TURN;
-            while (true) {
-                entry.cell = (CellLocation)cellDist(rng);
-                if (entry.cell != lastCell) break;
-                if (entry.cell == LEFT || entry.cell == RIGHT) break;
-            }
-            lastCell = entry.cell;
-            switch (entry.cell) {
-                case IN:
-                case OUT:
-                    // YZ or ZY
-                    entry.direction = (RotateDirection)boolDist(rng);
-                    break;
-                case UP:
-                case DOWN:
-                    // XZ or ZX
-                    entry.direction = (RotateDirection)(2 + boolDist(rng));
-                    break;
-                case FRONT:
-                case BACK:
-                    // XY or YX
-                    entry.direction = (RotateDirection)(4 + boolDist(rng));
-                    break;
-                case LEFT:
-                case RIGHT:
-                    // any
-                    entry.direction = (RotateDirection)directionDist(rng);
-                    break;
-            }
-        }
-        scramble.push_back(entry);
+    wakeSimulation();
+}
+
+bool PuzzleController::finishHint() {
+    std::vector<MoveEntry> moves;
+    bool found;
+    {
+        std::lock_guard<std::mutex> lock(hintMutex);
+        if (!hintReady) return false;
+        hintReady = false;
+        found = hintFound;
+        moves.swap(hintMoves);
     }
-
-    bool reorient = false;
-    if (reorient) {
-        // R, L, U, D, F, B, O, I
-        // Reorient to HSC default orientation
-        std::array<int, 8> cells = {0, 1, 4, 5, 3, 2, 6, 7};
-        for (size_t i = 0; i < scramble.size(); i++) {
-            if (scramble[i].type == GYRO) {
-                rotate8bycell(cells, scramble[i].cell);
-            }
-        }
-        entry.type = GYRO;
-        std::array<int, 3> colorsToFix = {4, 2, 7};
-        for (int i = 0; i < 3; i++) {
-            int index = std::distance(cells.begin(), std::find(cells.begin(), cells.end(), colorsToFix[i]));
-            if (index != colorsToFix[i]) {
-                // Move to I
-                if (index == 6) {
-                    entry.cell = LEFT;
-                    scramble.push_back(entry);
-                    scramble.push_back(entry);
-                    rotate8bycell(cells, entry.cell);
-                    rotate8bycell(cells, entry.cell);
-                } else if (index < 6) {
-                    entry.cell = (CellLocation)(2 + index);
-                    scramble.push_back(entry);
-                    rotate8bycell(cells, entry.cell);
-                }
-                // Move to desired location (gyro opposite)
-                if (colorsToFix[i] != 7) {
-                    // Don't gyro if inner
-                    entry.cell = (CellLocation)(2 + colorsToFix[i] + 1);
-                    scramble.push_back(entry);
-                    rotate8bycell(cells, entry.cell);
-                }
-            }
+    hintSearching = false;
+    std::ostringstream hintStatus;
+    if (*puzzle != hintStart) {
+        hintStatus << "Error: the puzzle changed while searching for a hint!";
+    } else if (!found) {
+        hintStatus << "Error: no hint within " << HINT_DEPTH << " moves!";
+    } else if (moves.empty()) {
+        hintStatus << "Nothing to hint, puzzle is solved!";
+    } else {
+        scheduleMoves(moves);
+        hintStatus << "Hint: " << moves.size() << " moves solve piece " << solver->getHintProgress() + 1
+                   << " of " << solver->getHintPieces() << " in a cell";
+        if (solver->getHintKept() == HINT_KEPT_CELL) {
+            hintStatus << ", unfinished cells may be broken up";
+        } else if (solver->getHintKept() == HINT_KEPT_NONE) {
+            hintStatus << ", other pieces may be broken up";
         }
+        hintStatus << "!";
     }
-
-    getScrambleTwists();
-    scrambleIndex = 0;
-    performScramble();
-    status = "Scrambled puzzle!";
+    status = hintStatus.str();
+    return true;
 }
 
-void PuzzleController::performScramble() {
-    static float origRenderSpeed;
-    if (scrambleIndex == 0) {
-        origRenderSpeed = renderer->animationSpeed;
-        renderer->animationSpeed = 40.0f;
-    }
-    if ((size_t)scrambleIndex == scramble.size()) {
-        scrambleIndex = -1;
-        renderer->animationSpeed = origRenderSpeed;
-    } else {
-        if (scramble[scrambleIndex].type == GYRO) {
-            startGyro(scramble[scrambleIndex].cell);
-        } else {
-            startCellMove(scramble[scrambleIndex].cell, scramble[scrambleIndex].direction);
-        }
-    }
+bool PuzzleController::canSeek() {
+    return !animator.isAnimating();
 }
 
-void PuzzleController::getScrambleTwists() {
-    std::map<CellLocation, std::pair<int, int>> gyroMoves = {
-        {RIGHT, {2, 4}}, // U cell turns F
-        {LEFT, {2, 5}}, // U cell turns B
-        {UP, {4, 0}}, // F cell turns R
-        {DOWN, {4, 1}}, // F cell turns L
-        {FRONT, {2, 1}}, // U cell turns R
-        {BACK, {2, 0}} // U cell turns L
-    };
-    std::ostringstream hscScramble;
-    hscScramble << 0 << "," << 0 << "," << 7 << " ";
-    for (size_t i = 0; i < scramble.size(); i++) {
-        if (scramble[i].type == GYRO) {
-            hscScramble << gyroMoves[scramble[i].cell].first << "," << gyroMoves[scramble[i].cell].second;
-            hscScramble << "," << 7 << " ";
-        } else {
-            int cell, direction;
-            if (scramble[i].cell == IN) {
-                cell = 7;
-            } else if (scramble[i].cell == OUT) {
-                cell = 6;
-            } else {
-                cell = (int)scramble[i].cell - 2;
-            }
-            direction = (int)scramble[i].direction;
-            if (cell >= 2 && cell < 6) direction += 6;
-            hscScramble << cell << "," << direction << "," << 1 << " ";
-        }
+void PuzzleController::seekMove(size_t index) {
+    if (!canSeek()) {
+        status = "Error: moves are still animating!";
+        return;
     }
-
-    std::ostringstream physScramble;
-    for (size_t i = 0; i < scramble.size(); i++) {
-        if (scramble[i].type == GYRO) {
-            physScramble << (int)scramble[i].cell << "," << -1 << " ";
-        } else {
-            physScramble << scramble[i].cell << "," << (int)scramble[i].direction << " ";
-        }
+    if (simulation->seek(index)) {
+        markStateChanged();
+        std::ostringstream seekStatus;
+        seekStatus << "Moved to " << history->getMoveCount() << " of " << history->getLength() << " moves!";
+        status = seekStatus.str();
     }
-    std::cout << "scramble: >\n  " << hscScramble.str() << std::endl;
-    std::cout << "phys_scramble: >\n  " << physScramble.str() << std::endl;
 }
 
-void PuzzleController::openFile(std::string filename) {
-    std::ostringstream loadStatus;
-    loadStatus << "Loaded log file from " << filename;
-    status = loadStatus.str();
+void PuzzleController::armTimer() {
+    // Starts on the first user move
+    timerArmed = true;
+    timerRunning = false;
+    solveTime = 0.0;
 }
 
-std::string PuzzleController::getStatus() {
-    return status;
-}
-
-MoveHistory::MoveHistory() {
-    turnCount = 0;
-    undoing = false;
-    redoing = false;
-}
-
-void MoveHistory::reset() {
-    turnCount = 0;
-    history.clear();
-    redoList.clear();
+double PuzzleController::getSolveTime() {
+    if (timerRunning) {
+        return glfwGetTime() - timerStart;
+    }
+    return solveTime;
 }
 
-void MoveHistory::insertMove(MoveEntry entry) {
-    if (undoing) {
-        if (entry.type == TURN) {
-            turnCount -= 1;
-        }
-        undoing = false;
-    } else if (history.size() && isOpposite(entry, history.back())) {
-        redoList.push_back(history.back());
-        history.pop_back();
-        if (entry.type == TURN) {
-            turnCount -= 1;
-        }
-    } else {
-        if (!redoing) {
-            redoList.clear();
-        } else {
-            redoing = false;
-        }
-        history.push_back(entry);
-        if (entry.type == TURN) {
-            turnCount += 1;
-        }
-    }
+bool PuzzleController::isTimerRunning() {
+    return timerRunning;
 }
 
-bool MoveHistory::undoMove(MoveEntry *entry) {
-    if (!history.size()) {
-        return false;
-    }
-    MoveEntry lastEntry = history.back();
-    *entry = getOpposite(lastEntry);
-    undoing = true;
-    redoList.push_back(lastEntry);
-    history.pop_back();
-    return true;
+bool PuzzleController::isSolved() {
+    return shownPuzzle.isSolved();
 }
 
-bool MoveHistory::redoMove(MoveEntry *entry) {
-    if (!redoList.size()) {
-        return false;
-    }
-    *entry = redoList.back();
-    redoList.pop_back();
-    redoing = true;
-    return true;
+void PuzzleController::setInstancing(bool instancing) {
+    renderer->setInstancing(instancing);
+    // Only instanced rendering can draw several moves at once
+    animator.setGrouping(instancing);
 }
 
-bool MoveHistory::canUndo() {
-    return history.size() > 0;
+int PuzzleController::getBacklogDepth() {
+    return animator.getBacklogDepth();
 }
 
-bool MoveHistory::canRedo() {
-    return redoList.size() > 0;
+void PuzzleController::setBacklogDepth(int depth) {
+    animator.setBacklogDepth(depth);
 }
 
-int MoveHistory::getTurnCount() {
-    return turnCount;
+void PuzzleController::scramblePuzzle(int scrambleLength) {
+    applyMovesImmediate(simulation->generateScramble(scrambleLength));
+    getScrambleTwists();
+    armTimer();
+    status = "Scrambled puzzle!";
 }
 
-bool isOppositeParity(int a, int b) {
-    return a / 2 == b / 2 && a % 2 == 1 - b % 2;
+void PuzzleController::applyMovesImmediate(const std::vector<MoveEntry>& moves) {
+    simulation->applyMovesImmediate(moves);
+    markStateChanged();
 }
 
-int getOppositeParity(int a) {
-    return a / 2 * 2 + (1 - a % 2);
+void PuzzleController::getScrambleTwists() {
+    std::cout << "scramble: >\n  " << simulation->getHscScramble() << std::endl;
+    std::cout << "phys_scramble: >\n  " << simulation->getPhysScramble() << std::endl;
 }
 
-bool MoveHistory::isOpposite(MoveEntry entry1, MoveEntry entry2) {
-    if (entry1.type != entry2.type) {
-        return false;
+void PuzzleController::openFile(std::string filename) {
+    std::string error;
+    bool loaded = simulation->loadLog(filename, error);
+    markStateChanged();
+    timerArmed = false;
+    timerRunning = false;
+    solveTime = -1.0;
+    if (!loaded) {
+        status = "Error: " + error;
+        return;
     }
-    switch (entry1.type) {
-        case GYRO:
-            return isOppositeParity((int)entry1.cell, (int)entry2.cell);
-        case TURN:
-            return entry1.cell == entry2.cell && isOppositeParity((int)entry1.direction, (int)entry2.direction);
-        case ROTATE:
-            return isOppositeParity((int)entry1.direction, (int)entry2.direction);
-        case GYRO_OUTER:
-            return entry1.location == -entry2.location;
-        case GYRO_MIDDLE:
-            return entry1.location == -entry2.location;
-        default:
-            // should not run
-            return false;
+    if (simulation->getScramble().size() && !puzzle->isSolved()) {
+        armTimer();
     }
+    std::ostringstream loadStatus;
+    loadStatus << "Loaded log file from " << filename;
+    status = loadStatus.str();
 }
 
-MoveEntry MoveHistory::getOpposite(MoveEntry entry) {
-    MoveEntry opposite;
-    opposite.type = entry.type;
-    opposite.animLength = entry.animLength;
-    switch (entry.type) {
-        case GYRO:
-            opposite.cell = (CellLocation)getOppositeParity((int)entry.cell);
-            break;
-        case TURN:
-            opposite.cell = entry.cell;
-            opposite.direction = (RotateDirection)getOppositeParity((int)entry.direction);
-            break;
-        case ROTATE:
-            opposite.direction = (RotateDirection)getOppositeParity((int)entry.direction);
-            break;
-        case GYRO_OUTER:
-            opposite.location = -entry.location;
-            break;
-        case GYRO_MIDDLE:
-            opposite.location = -entry.location;
-            break;
+void PuzzleController::saveFile(std::string filename) {
+    if (simulation->saveLog(filename)) {
+        status = "Saved log file to " + filename;
+    } else {
+        status = "Error: could not save to " + filename;
     }
-    return opposite;
+}
+
+std::string PuzzleController::getStatus() {
+    return status;
 }
 
 bool PuzzleController::checkOutline(GLFWwindow *window, Shader *shader, bool flip) {
     CellLocation cell;
-    if (checkCellKeys(window, &cell, flip)) {
+    unsigned int heldCells = getHeldCells(window);
+    if (selectedCell != -1) heldCells |= 1u << flipCell(selectedCell, flip);
+    if (checkCellKeys(heldCells, &cell, flip)) {
         renderer->renderCellOutline(shader, cell);
         return true;
     }
+    if (hoverCell != -1) {
+        renderer->renderCellOutline(shader, (CellLocation)hoverCell);
+        return true;
+    }
     return false;
 }
+
+bool PuzzleController::setHoverCell(int cell) {
+    if (cell == hoverCell) return false;
+    hoverCell = cell;
+    return true;
+}
+
+void PuzzleController::clickCell(int cell) {
+    selectedCell = (cell == selectedCell) ? -1 : cell;
+}
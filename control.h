@@ -23,57 +23,87 @@
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 #include <string>
-#include <random>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#ifndef __EMSCRIPTEN__
+#include <thread>
+#endif
 #include "render.h"
 #include "puzzle.h"
+#include "history.h"
+#include "simulation.h"
+#include "solver.h"
+#include "animation.h"
+#include "sync.h"
 
-void showError(std::string text);
-
-class MoveHistory {
-	public:
-		MoveHistory();
-		void reset();
-		void insertMove(MoveEntry entry);
-		bool isOpposite(MoveEntry entry1, MoveEntry entry2);
-		MoveEntry getOpposite(MoveEntry entry);
-		bool undoMove(MoveEntry* entry);
-		bool redoMove(MoveEntry* entry);
-		bool canUndo();
-		bool canRedo();
-		int getTurnCount();
+// Longest simulation step while moves are animating
+#define SIMULATION_STEP (1.0 / 240)
 
-	private:
-		int turnCount;
-		std::vector<MoveEntry> history;
-		std::vector<MoveEntry> redoList;
-		bool undoing;
-		bool redoing;
-};
+void showError(std::string text);
 
 class PuzzleController {
 	public:
 		friend class GuiRenderer;
-		PuzzleController(PuzzleRenderer* renderer);
+		// Steps the puzzle on its own thread, except in the browser where
+		// the main loop calls stepSimulation instead
+		PuzzleController(Puzzle* puzzle, PuzzleRenderer* renderer);
 		~PuzzleController();
-		bool updatePuzzle(GLFWwindow* window, double dt);
+		// Handles queued key presses and advances animations, then publishes a snapshot
+		void stepSimulation(double dt);
+		bool updatePuzzle(double dt);
+        // Copies the latest snapshot into frame, true if there was a newer one
+        bool readSnapshot(PuzzleSnapshot& frame);
+        // Held by each simulation step, anything else calling into the
+        // controller from the main thread must hold it too
+        std::mutex& getStateMutex();
+        // Wakes an idle simulation thread after moves or changes from the main thread
+        void wakeSimulation();
         bool checkMiddleGyro(int key, bool flip);
-        bool checkDirectionalMove(GLFWwindow* window, int key, bool flip);
+        bool checkDirectionalMove(unsigned int heldCells, int key, bool flip);
         void startGyro(CellLocation cell);
-        bool checkCellKeys(GLFWwindow* window, CellLocation* cell, bool flip);
+        static unsigned int getHeldCells(GLFWwindow* window);
+        bool checkCellKeys(unsigned int heldCells, CellLocation* cell, bool flip);
         bool checkDirectionKey(int key, RotateDirection* direction, bool flip);
         void startCellMove(CellLocation cell, RotateDirection direction);
+        // Queues the press for the simulation thread, with the cell keys held now
         void keyCallback(GLFWwindow* window, int key, int action, int mods, bool flip);
+        void handleKey(const InputEvent& event);
         std::string getStatus();
         bool checkOutline(GLFWwindow *window, Shader *shader, bool flip);
+        // Cell under the cursor, outlined when no cell is held. True if it changed
+        bool setHoverCell(int cell);
+        // Selects the cell as if its key were held, clicking it again or
+        // clicking off the puzzle with -1 lets go
+        void clickCell(int cell);
+        // Makes and records the move right away, its animation follows
         void performMove(MoveEntry entry);
-        void performScramble();
+        // Skips the animation queue, the scene is redrawn once afterwards
+        void applyMovesImmediate(const std::vector<MoveEntry>& moves);
         void getScrambleTwists();
 
         void resetPuzzle();
         void scramblePuzzle(int scrambleLength);
         void undoMove();
         void redoMove();
+        // Starts searching for the moves that solve one more piece of a cell,
+        // they are animated by the simulation step after the search finishes
+        void showHint();
+        // Jumps straight to a point in the history, once no moves are animating
+        bool canSeek();
+        void seekMove(size_t index);
         void openFile(std::string filename);
+        void saveFile(std::string filename);
+        // Seconds since the first move after a scramble, -1 if no scramble
+        double getSolveTime();
+        bool isTimerRunning();
+        // Whether the puzzle as shown is solved, queued moves may still change it
+        bool isSolved();
+        // Also animates commuting turns together, which needs instancing
+        void setInstancing(bool instancing);
+        // Queued moves past this speed up their animations, see MoveAnimator
+        int getBacklogDepth();
+        void setBacklogDepth(int depth);
 
 	    static int cellKeys[];
     	static int directionKeys[];
@@ -81,11 +111,58 @@ class PuzzleController {
 	private:
 		PuzzleRenderer *renderer;
 		Puzzle *puzzle;
+		PuzzleSimulation *simulation;
+		Solver *solver;
 		MoveHistory *history;
 		std::string status;
-		std::mt19937 rng;
-		int scrambleIndex;
-		std::vector<MoveEntry> scramble;
+		bool timerArmed;
+		bool timerRunning;
+		double timerStart;
+		double solveTime;
+
+		// Lags behind puzzle by the moves still animating
+		Puzzle shownPuzzle;
+		MoveAnimator animator;
+		InputQueue inputQueue;
+		SnapshotBuffer snapshots;
+		uint64_t stateVersion;
+		uint64_t changes;
+		uint64_t postedChanges;
+		std::mutex stateMutex;
+		std::mutex wakeMutex;
+		std::condition_variable wake;
+		bool wakePending;
+		bool stopping;
+		// Only used from the main thread
+		int hoverCell;
+		int selectedCell;
+#ifndef __EMSCRIPTEN__
+		std::thread simulationThread;
+		void simulationLoop();
+#endif
+		// Hints are searched away from both the window and the simulation,
+		// the solver is only used by one search at a time
+		bool hintSearching;
+		Puzzle hintStart;
+		std::mutex hintMutex;
+		bool hintReady;
+		bool hintFound;
+		std::vector<MoveEntry> hintMoves;
+#ifndef __EMSCRIPTEN__
+		std::thread hintThread;
+#endif
+		void searchHint(Puzzle start);
+		// Makes the moves of a finished search, if the puzzle is still where it started
+		bool finishHint();
+
+		void armTimer();
+		void scheduleMove(MoveEntry entry);
+		void scheduleMoves(const std::vector<MoveEntry>& moves);
+		// Call whenever the puzzle state changes outside of an animation
+		void markStateChanged();
+		void publishSnapshot();
+		// Swaps cells mirrored by a flipped camera, undoes itself
+		static int flipCell(int cell, bool flip);
 };
 
 #endif // control.h
@@ -0,0 +1,436 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+#include <glad/gl.h>
+#include <linmath.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "camera.h"
+#include "render.h"
+#include "simulation.h"
+#include "shaders.h"
+#include "constants.h"
+
+// Usage: exporter [options] log.yaml
+// Plays a move log back at a fixed timestep in a hidden window and writes
+// every frame, either as PNG files or as raw RGB on stdout for ffmpeg:
+//   exporter --raw log.yaml | ffmpeg -f rawvideo -pix_fmt rgb24 -s 1280x720 -r 60 -i - out.mp4
+// Options:
+//   --size WxH        frame size, 1280x720
+//   --fps N           frames per second of the timeline, 60
+//   --speed N         animation units per second, 4 as in the app
+//   --hold S          seconds shown still before and after the moves, 0.5
+//   --camera FILE     "time yaw pitch zoom" keyframes, angles in degrees
+//   --samples N       MSAA samples, 4
+//   --shader-edges    outline faces in the shader instead of drawing lines
+//   --range A:B       only frames A up to B, so several processes can split one log
+//   --png PREFIX      write PREFIX00000.png and so on, the default is frame
+//   --raw             write frames to stdout instead
+//   --egl             create the context with EGL rather than the native API
+//   --osmesa          no display at all, with GLFW 3.4 built with OSMesa
+
+// Frames in flight between glReadPixels and writing them out
+#define READBACK_BUFFERS 3
+#define DEFAULT_YAW -20.0f
+#define DEFAULT_PITCH -20.0f
+
+struct CameraKey {
+    double time;
+    float yaw, pitch, zoom;
+};
+
+struct ExportOptions {
+    int width = 1280, height = 720;
+    double fps = 60.0;
+    double speed = 4.0;
+    double hold = 0.5;
+    int samples = 4;
+    bool shaderEdges = false;
+    long first = 0, end = -1;
+    std::string prefix = "frame";
+    bool raw = false;
+    bool egl = false;
+    bool osmesa = false;
+    std::string cameraFile;
+    std::string logFile;
+};
+
+static bool parseOptions(int argc, char *argv[], ExportOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--size" && hasValue) {
+            if (std::sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2) return false;
+        } else if (arg == "--fps" && hasValue) {
+            options.fps = std::atof(argv[++i]);
+        } else if (arg == "--speed" && hasValue) {
+            options.speed = std::atof(argv[++i]);
+        } else if (arg == "--hold" && hasValue) {
+            options.hold = std::max(std::atof(argv[++i]), 0.0);
+        } else if (arg == "--camera" && hasValue) {
+            options.cameraFile = argv[++i];
+        } else if (arg == "--samples" && hasValue) {
+            options.samples = std::max(std::atoi(argv[++i]), 0);
+        } else if (arg == "--shader-edges") {
+            options.shaderEdges = true;
+        } else if (arg == "--range" && hasValue) {
+            if (std::sscanf(argv[++i], "%ld:%ld", &options.first, &options.end) != 2) return false;
+        } else if (arg == "--png" && hasValue) {
+            options.prefix = argv[++i];
+        } else if (arg == "--raw") {
+            options.raw = true;
+        } else if (arg == "--egl") {
+            options.egl = true;
+        } else if (arg == "--osmesa") {
+            options.osmesa = true;
+        } else if (arg[0] != '-' && options.logFile.empty()) {
+            options.logFile = arg;
+        } else {
+            return false;
+        }
+    }
+    return !options.logFile.empty() && options.width > 0 && options.height > 0 &&
+        options.fps > 0 && options.speed > 0;
+}
+
+static bool loadCameraPath(std::string filename, std::vector<CameraKey>& keys) {
+    std::ifstream file(filename);
+    if (file.fail()) return false;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream values(line);
+        CameraKey key;
+        if (!(values >> key.time >> key.yaw >> key.pitch >> key.zoom)) return false;
+        keys.push_back(key);
+    }
+    std::sort(keys.begin(), keys.end(), [](const CameraKey& a, const CameraKey& b) {
+        return a.time < b.time;
+    });
+    return !keys.empty();
+}
+
+// Linear between keyframes, held before the first and after the last
+static void setCamera(Camera& camera, const std::vector<CameraKey>& keys, double time) {
+    size_t next = 0;
+    while (next < keys.size() && keys[next].time <= time) next++;
+    const CameraKey& a = keys[next ? next - 1 : 0];
+    const CameraKey& b = keys[std::min(next, keys.size() - 1)];
+    float t = (b.time > a.time) ? (float)((time - a.time) / (b.time - a.time)) : 0.0f;
+    t = std::min(std::max(t, 0.0f), 1.0f);
+    camera.setYaw(M_PI / 180 * (a.yaw + (b.yaw - a.yaw) * t));
+    camera.setPitch(M_PI / 180 * (a.pitch + (b.pitch - a.pitch) * t));
+    camera.setZoom(a.zoom + (b.zoom - a.zoom) * t);
+}
+
+static unsigned int crcTable[256];
+
+static void initCrc() {
+    for (unsigned int i = 0; i < 256; i++) {
+        unsigned int c = i;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        crcTable[i] = c;
+    }
+}
+
+static unsigned int crc(unsigned int c, const unsigned char *data, size_t length) {
+    for (size_t i = 0; i < length; i++) c = crcTable[(c ^ data[i]) & 0xff] ^ (c >> 8);
+    return c;
+}
+
+static void putBigEndian(std::vector<unsigned char>& out, unsigned int value) {
+    for (int shift = 24; shift >= 0; shift -= 8) out.push_back((value >> shift) & 0xff);
+}
+
+static void writeChunk(FILE *file, const char *type, const std::vector<unsigned char>& data) {
+    std::vector<unsigned char> chunk;
+    putBigEndian(chunk, data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    putBigEndian(chunk, crc(0xffffffffu, &chunk[4], chunk.size() - 4) ^ 0xffffffffu);
+    std::fwrite(chunk.data(), 1, chunk.size(), file);
+}
+
+// RGB rows top to bottom. Deflate blocks are stored uncompressed, which
+// keeps encoding cheaper than rendering, ffmpeg or optipng can shrink them
+static bool writePng(std::string filename, const unsigned char *rgb, int width, int height) {
+    FILE *file = std::fopen(filename.c_str(), "wb");
+    if (!file) return false;
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    std::fwrite(signature, 1, 8, file);
+
+    std::vector<unsigned char> header;
+    putBigEndian(header, width);
+    putBigEndian(header, height);
+    // 8 bit RGB, no interlacing
+    const unsigned char format[5] = {8, 2, 0, 0, 0};
+    header.insert(header.end(), format, format + 5);
+    writeChunk(file, "IHDR", header);
+
+    size_t stride = (size_t)width * 3;
+    std::vector<unsigned char> raw;
+    raw.reserve((stride + 1) * height);
+    for (int y = 0; y < height; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgb + y * stride, rgb + (y + 1) * stride);
+    }
+    std::vector<unsigned char> data = {0x78, 0x01};
+    for (size_t offset = 0; offset < raw.size() || offset == 0; offset += 0xffff) {
+        size_t length = std::min<size_t>(raw.size() - offset, 0xffff);
+        data.push_back(offset + length >= raw.size());
+        data.push_back(length & 0xff);
+        data.push_back(length >> 8);
+        data.push_back(~length & 0xff);
+        data.push_back((~length >> 8) & 0xff);
+        data.insert(data.end(), raw.begin() + offset, raw.begin() + offset + length);
+    }
+    unsigned int a = 1, b = 0;
+    for (size_t i = 0; i < raw.size(); i++) {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    putBigEndian(data, (b << 16) | a);
+    writeChunk(file, "IDAT", data);
+    writeChunk(file, "IEND", std::vector<unsigned char>());
+    return std::fclose(file) == 0;
+}
+
+// Renderbuffers for one export, MSAA resolved into a target that is read back
+struct ExportTarget {
+    unsigned int sceneFbo, resolveFbo;
+    unsigned int buffers[3];
+    bool create(int width, int height, int samples);
+};
+
+bool ExportTarget::create(int width, int height, int samples) {
+    glGenFramebuffers(1, &sceneFbo);
+    glGenFramebuffers(1, &resolveFbo);
+    glGenRenderbuffers(3, buffers);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, buffers[0]);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, buffers[0]);
+    glBindRenderbuffer(GL_RENDERBUFFER, buffers[1]);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH24_STENCIL8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, buffers[1]);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, resolveFbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, buffers[2]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, buffers[2]);
+    return complete && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+int main(int argc, char *argv[]) {
+    ExportOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        std::fprintf(stderr, "Usage: exporter [--size WxH] [--fps N] [--speed N] [--hold S] [--camera FILE]\n"
+            "    [--samples N] [--shader-edges] [--range A:B] [--png PREFIX | --raw] [--egl | --osmesa] log.yaml\n");
+        return 1;
+    }
+
+    std::vector<CameraKey> cameraPath;
+    if (options.cameraFile.empty()) {
+        // Same view the app starts with
+        Camera camera(M_PI_4, options.width, options.height, 0.02, 50);
+        cameraPath.push_back({0.0, DEFAULT_YAW, DEFAULT_PITCH, camera.getZoom()});
+    } else if (!loadCameraPath(options.cameraFile, cameraPath)) {
+        std::fprintf(stderr, "Could not read camera path %s\n", options.cameraFile.c_str());
+        return 1;
+    }
+
+    Puzzle puzzle;
+    PuzzleSimulation simulation(&puzzle);
+    std::string error;
+    if (!simulation.loadLog(options.logFile, error)) {
+        std::fprintf(stderr, "Could not load %s: %s\n", options.logFile.c_str(), error.c_str());
+        return 1;
+    }
+    std::vector<MoveEntry> moves = simulation.getHistory()->getMoves();
+    // Back to the scrambled state, moves are made again as the timeline reaches them
+    simulation.seek(0);
+
+    // Each move starts when the one before it ends, as in the app without a backlog
+    std::vector<double> starts(moves.size() + 1);
+    starts[0] = options.hold;
+    for (size_t i = 0; i < moves.size(); i++) {
+        float length = moves[i].animLength > 0 ? moves[i].animLength : PuzzleSimulation::getAnimLength(moves[i]);
+        starts[i + 1] = starts[i] + length / options.speed;
+    }
+    long frameCount = (long)std::ceil((starts.back() + options.hold) * options.fps) + 1;
+    long first = std::min(std::max(options.first, 0L), frameCount);
+    long end = (options.end < 0) ? frameCount : std::min(std::max(options.end, first), frameCount);
+
+#ifdef GLFW_PLATFORM_NULL
+    if (options.osmesa) glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#else
+    if (options.osmesa) {
+        std::fprintf(stderr, "--osmesa needs GLFW 3.4 or later\n");
+        return 1;
+    }
+#endif
+    if (!glfwInit()) {
+        std::fprintf(stderr, "Failed to init GLFW\n");
+        return 1;
+    }
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    if (options.egl) glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+    if (options.osmesa) glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+    GLFWwindow *window = glfwCreateWindow(options.width, options.height, "3to4++ export", NULL, NULL);
+    if (!window) {
+        std::fprintf(stderr, "Failed to create window\n");
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGL(glfwGetProcAddress)) {
+        std::fprintf(stderr, "Failed to load GL\n");
+        glfwTerminate();
+        return 1;
+    }
+    glfwSwapInterval(0);
+
+    int maxSamples;
+    glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+    // Hidden windows may have no usable default framebuffer
+    ExportTarget target;
+    if (!target.create(options.width, options.height, std::min(options.samples, maxSamples))) {
+        std::fprintf(stderr, "Failed to create a %dx%d framebuffer\n", options.width, options.height);
+        glfwTerminate();
+        return 1;
+    }
+    glViewport(0, 0, options.width, options.height);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+    glDepthMask(GL_TRUE);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(1.0, 1.0);
+    glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
+
+    size_t frameSize = (size_t)options.width * options.height * 4;
+    unsigned int readback[READBACK_BUFFERS];
+    glGenBuffers(READBACK_BUFFERS, readback);
+    for (int i = 0; i < READBACK_BUFFERS; i++) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frameSize, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    Shader *shader = new Shader(Shaders::modelVertex, Shaders::modelFragment);
+    Camera camera(M_PI_4, options.width, options.height, 0.02, 50);
+    Puzzle shown;
+    PuzzleRenderer *renderer = new PuzzleRenderer(&shown);
+    renderer->setShaderEdges(options.shaderEdges);
+    initCrc();
+
+    // Converts a mapped frame to RGB top to bottom and writes it
+    std::vector<unsigned char> rgb((size_t)options.width * options.height * 3);
+    bool failed = false;
+    auto writeFrame = [&](long index, const unsigned char *rgba) {
+        for (int y = 0; y < options.height; y++) {
+            const unsigned char *row = rgba + (size_t)(options.height - 1 - y) * options.width * 4;
+            unsigned char *out = &rgb[(size_t)y * options.width * 3];
+            for (int x = 0; x < options.width; x++) {
+                std::memcpy(out + x * 3, row + x * 4, 3);
+            }
+        }
+        if (options.raw) {
+            failed |= std::fwrite(rgb.data(), 1, rgb.size(), stdout) != rgb.size();
+        } else {
+            char number[16];
+            std::snprintf(number, sizeof(number), "%05ld", index);
+            failed |= !writePng(options.prefix + number + ".png", rgb.data(), options.width, options.height);
+        }
+    };
+    auto collect = [&](long index) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback[index % READBACK_BUFFERS]);
+        void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameSize, GL_MAP_READ_BIT);
+        if (pixels) writeFrame(index, (const unsigned char*)pixels);
+        failed |= !pixels;
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    };
+
+    PuzzleSnapshot frame;
+    frame.puzzle = puzzle;
+    frame.stateVersion = 1;
+    size_t made = 0;
+    for (long index = first; index < end && !failed; index++) {
+        double time = index / options.fps;
+        while (made < moves.size() && time >= starts[made + 1]) {
+            simulation.performMove(moves[made++]);
+            frame.puzzle = puzzle;
+            frame.stateVersion++;
+        }
+        frame.animating = made < moves.size() && time >= starts[made];
+        frame.moveCount = frame.animating ? 1 : 0;
+        frame.moves[0] = frame.animating ? moves[made] : MoveEntry();
+        frame.progress = frame.animating ? (float)((time - starts[made]) * options.speed) : 0.0f;
+        frame.moveSerial = made + 1;
+        renderer->setFrame(frame);
+
+        setCamera(camera, cameraPath, time);
+        renderer->setCamera(*camera.getViewMat(), *camera.getProjection());
+        glBindFramebuffer(GL_FRAMEBUFFER, target.sceneFbo);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        renderer->renderPuzzle(shader);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, target.sceneFbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target.resolveFbo);
+        glBlitFramebuffer(0, 0, options.width, options.height, 0, 0, options.width, options.height,
+            GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+        // Queued now, mapped once the frames after it are queued too
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, target.resolveFbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback[index % READBACK_BUFFERS]);
+        glReadPixels(0, 0, options.width, options.height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+        if (index - first >= READBACK_BUFFERS - 1) collect(index - (READBACK_BUFFERS - 1));
+    }
+    for (long index = std::max(end - (READBACK_BUFFERS - 1), first); index < end && !failed; index++) {
+        collect(index);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (failed) {
+        std::fprintf(stderr, "Failed to write frames\n");
+    } else {
+        std::fprintf(stderr, "Wrote frames %ld to %ld of %ld\n", first, end - 1, frameCount);
+    }
+
+    delete renderer;
+    delete shader;
+    glDeleteBuffers(READBACK_BUFFERS, readback);
+    glDeleteFramebuffers(1, &target.sceneFbo);
+    glDeleteFramebuffers(1, &target.resolveFbo);
+    glDeleteRenderbuffers(3, target.buffers);
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return failed ? 1 : 0;
+}
@@ -18,9 +18,12 @@
  **************************************************************************/
 
 #include <sstream>
+#include <iomanip>
+#include <algorithm>
 #include <linmath.h>
 #include <glad/gl.h>
 #include <cstdlib>
+#include <cstdio>
 #include <imgui.h>
 #include <imgui_internal.h>
 #include <imgui_impl_glfw.h>
@@ -29,6 +32,9 @@
 #include "gui.h"
 #include "font.h"
 #include "control.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "quality.h"
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #endif
@@ -61,6 +67,8 @@ GuiRenderer::GuiRenderer(GLFWwindow *window, PuzzleController *controller, int w
 	this->height = height;
 	showHelp = false;
 	modalToggle = false;
+	showPerformance = false;
+	showReplay = false;
 
 	ImGui::CreateContext();
 	ImGui_ImplGlfw_InitForOpenGL(window, true);
@@ -70,16 +78,29 @@ GuiRenderer::GuiRenderer(GLFWwindow *window, PuzzleController *controller, int w
 
 	float xscale, yscale;
 	glfwGetWindowContentScale(window, &xscale, &yscale);
+	double atlasStart = glfwGetTime();
+	// The interface only ever shows ASCII, the default ranges add Latin-1 too
+	static const ImWchar glyphRanges[] = {0x0020, 0x007E, 0};
+	ImFontConfig config;
+	config.GlyphRanges = glyphRanges;
+	// Text is placed on whole pixels, so oversampling adds rasterising time for nothing
+	config.OversampleH = 1;
+	config.PixelSnapH = true;
 	hudFont = io.Fonts->AddFontFromMemoryCompressedTTF(
 		notosans_compressed_data,
 		notosans_compressed_size,
-		20 * xscale
-	);
-	uiFont = io.Fonts->AddFontFromMemoryCompressedTTF(
-		notosans_compressed_data,
-		notosans_compressed_size,
-		16 * xscale
+		20 * xscale,
+		&config
 	);
+	// Shares the TTF the atlas just decompressed for the HUD size
+	const ImFontConfig& hudConfig = io.Fonts->ConfigData.back();
+	void *fontData = hudConfig.FontData;
+	int fontDataSize = hudConfig.FontDataSize;
+	config.FontDataOwnedByAtlas = false;
+	uiFont = io.Fonts->AddFontFromMemoryTTF(fontData, fontDataSize, 16 * xscale, &config);
+	// Otherwise built by the first frame, timed here instead
+	io.Fonts->Build();
+	FrameProfiler::get().setFontAtlasTime(1000 * (glfwGetTime() - atlasStart));
 
 #ifndef NO_DEMO_WINDOW
 	showDemoWindow = false;
@@ -97,6 +118,11 @@ bool GuiRenderer::captureMouse() {
 	return io.WantCaptureMouse;
 }
 
+bool GuiRenderer::wantsFrames() {
+	ImGuiIO& io = ImGui::GetIO();
+	return ImGui::IsAnyItemActive() || io.WantTextInput;
+}
+
 int GuiRenderer::getTextWidth(std::string text) {
 	return ImGui::CalcTextSize(text.c_str()).x;
 }
@@ -140,7 +166,39 @@ void GuiRenderer::framebufferSizeCallback(GLFWwindow* window, int width, int hei
 	this->height = height;
 }
 
+void GuiRenderer::readState() {
+	state.status = controller->getStatus();
+	state.solved = controller->isSolved();
+	state.solveTime = controller->getSolveTime();
+	state.turnCount = (int)history->getTurnCount();
+	state.canUndo = history->canUndo();
+	state.canRedo = history->canRedo();
+	state.canSeek = controller->canSeek();
+	state.normalising = history->isNormalising();
+	state.instancing = controller->renderer->getInstancing();
+	state.backlogDepth = controller->getBacklogDepth();
+	state.moveCount = (int)history->getMoveCount();
+	state.length = (int)history->getLength();
+}
+
+void GuiRenderer::queueAction(std::function<void()> action) {
+	actions.push_back(action);
+}
+
+void GuiRenderer::runActions() {
+	if (actions.empty()) return;
+	std::lock_guard<std::mutex> lock(controller->getStateMutex());
+	for (size_t i = 0; i < actions.size(); i++) {
+		actions[i]();
+	}
+	actions.clear();
+}
+
 void GuiRenderer::renderGui() {
+	{
+		std::lock_guard<std::mutex> lock(controller->getStateMutex());
+		readState();
+	}
 	ImGui_ImplOpenGL3_NewFrame();
 	ImGui_ImplGlfw_NewFrame();
 	ImGui::NewFrame();
@@ -149,6 +207,12 @@ void GuiRenderer::renderGui() {
 	displayMenuBar();
 	displayStatusBar();
 	displayModal();
+	if (showPerformance) {
+		displayPerformance();
+	}
+	if (showReplay) {
+		displayReplay();
+	}
 #ifndef NO_DEMO_WINDOW
 	if (showDemoWindow) {
 		ImGui::ShowDemoWindow();
@@ -161,6 +225,8 @@ void GuiRenderer::renderGui() {
 	ImGui::PopFont();
 
 	ImGui::Render();
+	// Anything clicked this frame shows from the next one
+	runActions();
 	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
@@ -168,12 +234,21 @@ void GuiRenderer::displayMenuBar() {
 	if (ImGui::BeginMainMenuBar()) {
 		if (ImGui::BeginMenu("File")) {
 			if (ImGui::MenuItem("Open", "Ctrl+O")) checkUnsaved("open another file");
+#ifdef __EMSCRIPTEN__
 			if (ImGui::MenuItem("Save", "Ctrl+S", false, false)) {}
+#else
+			if (ImGui::MenuItem("Save", "Ctrl+S")) saveLog();
+#endif
 			ImGui::EndMenu();
 		}
 		if (ImGui::BeginMenu("Edit")) {
-			if (ImGui::MenuItem("Undo", "Z", false, history->canUndo())) controller->undoMove();
-            if (ImGui::MenuItem("Redo", "Y", false, history->canRedo())) controller->redoMove();
+			if (ImGui::MenuItem("Undo", "Z", false, state.canUndo)) queueAction([this]() {controller->undoMove();});
+            if (ImGui::MenuItem("Redo", "Y", false, state.canRedo)) queueAction([this]() {controller->redoMove();});
+			if (ImGui::MenuItem("Hint", "Ctrl+H")) queueAction([this]() {controller->showHint();});
+			bool normalising = state.normalising;
+			if (ImGui::MenuItem("Cancel moves", NULL, &normalising)) {
+				queueAction([this, normalising]() {history->setNormalising(normalising);});
+			}
             ImGui::Separator();
 			if (ImGui::MenuItem("Reset", "Ctrl+R")) checkUnsaved("reset puzzle");
 			ImGui::EndMenu();
@@ -187,6 +262,39 @@ void GuiRenderer::displayMenuBar() {
 			ImGui::EndMenu();
 		}
 		if (ImGui::BeginMenu("Tools")) {
+			bool instancing = state.instancing;
+			if (ImGui::MenuItem("Instanced rendering", NULL, &instancing)) {
+				queueAction([this, instancing]() {controller->setInstancing(instancing);});
+			}
+			if (ImGui::MenuItem("Performance", NULL, &showPerformance)) {
+				FrameProfiler::get().setEnabled(showPerformance);
+			}
+			ImGui::MenuItem("Replay", NULL, &showReplay);
+			if (ImGui::BeginMenu("Frame pacing")) {
+				FrameScheduler& scheduler = FrameScheduler::get();
+				for (int i = 0; i < SYNC_MODE_COUNT; i++) {
+					SyncMode mode = (SyncMode)i;
+					if (ImGui::MenuItem(FrameScheduler::syncModeNames[i], NULL, scheduler.getSyncMode() == mode, scheduler.isSupported(mode))) {
+						scheduler.setSyncMode(mode);
+					}
+				}
+				ImGui::EndMenu();
+			}
+			if (ImGui::BeginMenu("Quality")) {
+				displayQualityMenu();
+				ImGui::EndMenu();
+			}
+			if (ImGui::BeginMenu("Move backlog")) {
+				// Queued moves before animations speed up to catch up
+				const int depths[] = {0, 2, 4, 8, 16};
+				for (int depth : depths) {
+					std::string label = depth ? std::to_string(depth) + " moves" : "Never speed up";
+					if (ImGui::MenuItem(label.c_str(), NULL, state.backlogDepth == depth)) {
+						queueAction([this, depth]() {controller->setBacklogDepth(depth);});
+					}
+				}
+				ImGui::EndMenu();
+			}
 #ifndef NO_DEMO_WINDOW
 			if (ImGui::MenuItem("Show demo window", NULL, &showDemoWindow)) {}
 #endif
@@ -200,6 +308,55 @@ void GuiRenderer::displayMenuBar() {
 	}
 }
 
+void GuiRenderer::displayQualityMenu() {
+	RenderQuality& quality = RenderQuality::get();
+	QualityTier tier = quality.getTier();
+	for (int i = 0; i < QUALITY_TIER_COUNT; i++) {
+		if (ImGui::MenuItem(RenderQuality::tierNames[i], NULL, tier == i)) {
+			quality.setTier((QualityTier)i);
+		}
+	}
+	ImGui::Separator();
+	QualitySettings settings = quality.getSettings();
+	if (ImGui::BeginMenu("MSAA")) {
+		const int samples[] = {0, 2, 4, 8};
+		for (int count : samples) {
+			std::string label = count ? std::to_string(count) + "x" : "Off";
+			bool supported = count <= quality.getMaxSamples();
+			if (ImGui::MenuItem(label.c_str(), NULL, settings.samples == count, supported)) {
+				settings.samples = count;
+				quality.setSettings(settings);
+			}
+		}
+		ImGui::EndMenu();
+	}
+	if (ImGui::BeginMenu("Render scale")) {
+		const float scales[] = {0.5f, 0.75f, 1.0f};
+		for (float scale : scales) {
+			std::string label = std::to_string((int)(scale * 100)) + "%";
+			if (ImGui::MenuItem(label.c_str(), NULL, settings.renderScale == scale)) {
+				settings.renderScale = scale;
+				quality.setSettings(settings);
+			}
+		}
+		ImGui::EndMenu();
+	}
+	if (ImGui::BeginMenu("Edges")) {
+		for (int i = 0; i < EDGE_MODE_COUNT; i++) {
+			if (ImGui::MenuItem(RenderQuality::edgeModeNames[i], NULL, settings.edges == i)) {
+				settings.edges = (EdgeMode)i;
+				quality.setSettings(settings);
+			}
+		}
+		ImGui::EndMenu();
+	}
+	ImGui::Separator();
+	bool automatic = quality.isAutomatic();
+	if (ImGui::MenuItem("Lower when slow", NULL, &automatic)) {
+		quality.setAutomatic(automatic);
+	}
+}
+
 void GuiRenderer::displayModal() {
     if (modalResolve) {
     	resolveModal();
@@ -257,25 +414,104 @@ void GuiRenderer::displayHUD() {
 		renderText("links now work lol", 5, y, red);
 	}
 
+#ifdef __EMSCRIPTEN__
 	std::string saveWarning = "No saving in this version!";
 	textWidth = getTextWidth(saveWarning);
 	renderText(saveWarning, width - 5 - textWidth, ImGui::GetFrameHeight(), red);
+#endif
 
 	std::string helpHint = "Help: H";
 	textWidth = getTextWidth(helpHint);
 	renderText(helpHint, width - 5 - textWidth, height - 5 - lineHeight - ImGui::GetFrameHeight(), white);
 }
 
+void GuiRenderer::displayPerformance() {
+	FrameProfiler& profiler = FrameProfiler::get();
+	ImGui::SetNextWindowPos({10, ImGui::GetFrameHeight() + 10}, ImGuiCond_FirstUseEver);
+	if (ImGui::Begin("Performance", &showPerformance, ImGuiWindowFlags_AlwaysAutoResize)) {
+		char overlay[32];
+		snprintf(overlay, sizeof(overlay), "avg %.2f ms", profiler.getAverageFrameTime());
+		ImGui::PlotHistogram("Frame", profiler.getFrameTimes(), PROFILE_FRAMES, profiler.getOffset(),
+			overlay, 0.0f, 50.0f, ImVec2(240, 60));
+		if (profiler.hasGpuTimer()) {
+			snprintf(overlay, sizeof(overlay), "avg %.2f ms", profiler.getAverageGpuTime());
+			ImGui::PlotHistogram("GPU", profiler.getGpuTimes(), PROFILE_FRAMES, profiler.getOffset(),
+				overlay, 0.0f, 16.7f, ImVec2(240, 60));
+		} else {
+			ImGui::TextDisabled("GPU timer queries unavailable");
+		}
+
+		if (ImGui::BeginTable("stages", 3)) {
+			ImGui::TableSetupColumn("CPU stage");
+			ImGui::TableSetupColumn("avg ms");
+			ImGui::TableSetupColumn("max ms");
+			ImGui::TableHeadersRow();
+			for (int i = 0; i < STAGE_COUNT; i++) {
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::Text("%s", FrameProfiler::stageNames[i]);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", profiler.getAverageStageTime((ProfileStage)i));
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", profiler.getMaxStageTime((ProfileStage)i));
+			}
+			ImGui::EndTable();
+		}
+
+		ImGui::Separator();
+		ImGui::Text("First frame: %.1f ms (font atlas %.1f ms)",
+			profiler.getFirstFrameTime(), profiler.getFontAtlasTime());
+		ImGui::Text("Draw calls: %u", profiler.getDrawCalls());
+		ImGui::Text("Uniform uploads: %u", profiler.getUniformUploads());
+		ImGui::Text("Instance uploads: %u", profiler.getBufferUploads());
+	}
+	ImGui::End();
+	if (!showPerformance) {
+		profiler.setEnabled(false);
+	}
+}
+
+void GuiRenderer::displayReplay() {
+	ImGui::SetNextWindowPos({10, height - 10.0f}, ImGuiCond_FirstUseEver, {0.0f, 1.0f});
+	if (ImGui::Begin("Replay", &showReplay, ImGuiWindowFlags_AlwaysAutoResize)) {
+		int position = state.moveCount;
+		int length = state.length;
+		ImGui::BeginDisabled(!state.canSeek);
+		if (ImGui::Button("|<")) position = 0;
+		ImGui::SameLine();
+		if (ImGui::Button("<")) position = std::max(position - 1, 0);
+		ImGui::SameLine();
+		ImGui::SetNextItemWidth(240);
+		ImGui::SliderInt("##position", &position, 0, length, "%d", ImGuiSliderFlags_AlwaysClamp);
+		ImGui::SameLine();
+		if (ImGui::Button(">")) position = std::min(position + 1, length);
+		ImGui::SameLine();
+		if (ImGui::Button(">|")) position = length;
+		ImGui::EndDisabled();
+		if (position != state.moveCount) {
+			queueAction([this, position]() {controller->seekMove(position);});
+		}
+		ImGui::Text("Move %d of %d", position, length);
+	}
+	ImGui::End();
+}
+
 void GuiRenderer::displayStatusBar() {
     ImGuiViewport* viewport = ImGui::GetMainViewport();
     ImGuiWindowFlags window_flags = ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_MenuBar;
     float height = ImGui::GetFrameHeight();
     if (ImGui::BeginViewportSideBar("##StatusBar", viewport, ImGuiDir_Down, height, window_flags)) {
 	    if (ImGui::BeginMenuBar()) {
-	        ImGui::Text("%s", controller->getStatus().c_str());
+	        ImGui::Text("%s", state.status.c_str());
 
 			std::ostringstream stream;
-			stream << "Move Count: " << history->getTurnCount();
+			if (state.solved) {
+				stream << "Solved | ";
+			}
+			if (state.solveTime >= 0.0) {
+				stream << "Time: " << std::fixed << std::setprecision(2) << state.solveTime << "s | ";
+			}
+			stream << "Move Count: " << state.turnCount;
 			std::string text = stream.str();
 
 	        ImGui::SameLine(
@@ -303,15 +539,33 @@ void GuiRenderer::keyCallback(GLFWwindow* window, int key, int action, int mods)
 				checkUnsaved("scramble", 0);
 			} else if (key == GLFW_KEY_R) {
 				checkUnsaved("reset puzzle");
+			} else if (key == GLFW_KEY_H) {
+				queueAction([this]() {controller->showHint();});
 			} else if (key == GLFW_KEY_O) {
 #ifndef __EMSCRIPTEN__
 				checkUnsaved("open another file");
+#endif
+			} else if (key == GLFW_KEY_S) {
+#ifndef __EMSCRIPTEN__
+				saveLog();
 #endif
 			}
 		}
 	}
 }
 
+void GuiRenderer::saveLog() {
+#ifndef __EMSCRIPTEN__
+	nfdchar_t *outPath = NULL;
+	nfdresult_t result = NFD_SaveDialog("yml", NULL, &outPath);
+	if (result == NFD_OKAY) {
+		std::string file(outPath);
+		free(outPath);
+		queueAction([this, file]() {controller->saveFile(file);});
+	}
+#endif
+}
+
 void GuiRenderer::checkUnsaved(std::string action, int argument) {
 	modalArg = argument;
 	checkUnsaved(action);
@@ -324,17 +578,20 @@ void GuiRenderer::checkUnsaved(std::string action) {
 
 void GuiRenderer::resolveModal() {
 	if (modalText == "reset puzzle") {
-		controller->resetPuzzle();
+		queueAction([this]() {controller->resetPuzzle();});
 	} else if (modalText == "scramble") {
-		controller->resetPuzzle();
-		controller->scramblePuzzle(modalArg);
+		int length = modalArg;
+		queueAction([this, length]() {
+			controller->resetPuzzle();
+			controller->scramblePuzzle(length);
+		});
 	} else if (modalText == "open another file") {
 #ifndef __EMSCRIPTEN__
 		nfdchar_t *outPath = NULL;
 		nfdresult_t result = NFD_OpenDialog(NULL, NULL, &outPath);
 		if (result == NFD_OKAY) {
 			std::string file(outPath);
-			controller->openFile(file);
+			queueAction([this, file]() {controller->openFile(file);});
 		}
 #endif
 	} else if (modalText == "exit") {
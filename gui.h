@@ -23,6 +23,7 @@
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 #include <imgui.h>
+#include <functional>
 #include "control.h"
 
 typedef struct {
@@ -32,6 +33,19 @@ typedef struct {
     long int advance;
 } GlyphInfo;
 
+// What the GUI shows of the controller, copied once per frame
+typedef struct {
+    std::string status;
+    bool solved;
+    double solveTime;
+    int turnCount;
+    bool canUndo, canRedo, canSeek;
+    bool normalising;
+    bool instancing;
+    int backlogDepth;
+    int moveCount, length;
+} GuiState;
+
 class GuiRenderer {
 	public:
 		static const char *fontFile;
@@ -43,16 +57,25 @@ class GuiRenderer {
 		void renderLink(std::string text, std::string link, float x, float y, int color, int index);
 		void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 		int getTextWidth(std::string text);
+		// Holds the controller's state mutex only to copy its state and to run actions
 		void renderGui();
+		// Runs controller calls queued since the last time, under the state mutex
+		void runActions();
 		void displayMenuBar();
+		void displayQualityMenu();
 		void displayHUD();
 		void displayModal();
 		void displayStatusBar();
+		void displayPerformance();
+		void displayReplay();
 		bool captureMouse();
+		// A widget is being dragged or typed into
+		bool wantsFrames();
 
 		void keyCallback(GLFWwindow* window, int key, int action, int mods);
 		void resolveModal();
 		void toggleHelp();
+		void saveLog();
 		void checkUnsaved(std::string action);
 		void checkUnsaved(std::string action, int argument);
 
@@ -65,6 +88,12 @@ class GuiRenderer {
 		std::string modalText;
 		int modalArg;
 		ImFont *hudFont, *uiFont;
+		bool showPerformance;
+		bool showReplay;
+		GuiState state;
+		std::vector<std::function<void()>> actions;
+		void readState();
+		void queueAction(std::function<void()> action);
 
 #ifndef NO_DEMO_WINDOW
 		bool showDemoWindow;
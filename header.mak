@@ -1,5 +1,5 @@
 CPPFLAGS = -Wall -Wextra -Werror -pedantic -Wno-unused-parameter -Wno-unknown-pragmas -Iinclude -Iimgui/ -Iimgui/backends/ -Infd/src/include/
-CXXFLAGS = --std=c++11
+CXXFLAGS = --std=c++11 -pthread
 ifeq ($(OS),Windows_NT)
 	CCLIBFLAGS = -Llib -lglfw3 -lopengl32 -lgdi32 -lshell32 -lole32 -luuid
 else
@@ -34,7 +34,22 @@ ifeq ($(MAKECMDGOALS),shared)
 	endif
 endif
 
+ifeq ($(MAKECMDGOALS),bench)
+	CPPFLAGS += -O2 -march=native -DNDEBUG
+endif
+
+ifneq ($(filter patterns scrambler exporter,$(MAKECMDGOALS)),)
+	CPPFLAGS += -O2 -DNDEBUG
+endif
+
+# emscripten is tuned for speed, emscripten-small for download size on slow connections.
+# Both build PuzzleBatch with wasm SIMD, which every current browser has
 ifeq ($(MAKECMDGOALS),emscripten)
-	CPPFLAGS += -s -Ofast -DNDEBUG -DNO_DEMO_WINDOW
+	CPPFLAGS += -s -Ofast -DNDEBUG -DNO_DEMO_WINDOW -msimd128
+	CPPFLAGS += -Wno-dollar-in-identifier-extension -x c++ -lglfw3
+endif
+
+ifeq ($(MAKECMDGOALS),emscripten-small)
+	CPPFLAGS += -s -Oz -DNDEBUG -DNO_DEMO_WINDOW -sMALLOC=emmalloc -msimd128
 	CPPFLAGS += -Wno-dollar-in-identifier-extension -x c++ -lglfw3
 endif
@@ -0,0 +1,323 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+#include "history.h"
+#include "movetable.h"
+#include <array>
+
+MoveHistory::MoveHistory() {
+    turnCount = 0;
+    undoing = false;
+    redoing = false;
+    normalising = false;
+}
+
+void MoveHistory::reset() {
+    turnCount = 0;
+    history.clear();
+    redoList.clear();
+    checkpoints.clear();
+}
+
+static_assert(OUTER_GYRO_POSITIVE == MOVE_COUNT, "history codes follow the move table");
+
+static bool isTurn(uint8_t move) {
+    return move < 24;
+}
+
+static int outerGyroIndex() {
+    MoveEntry entry;
+    entry.type = GYRO_OUTER;
+    return MoveTable::get().moveIndex(entry);
+}
+
+static int tableMove(uint8_t move) {
+    return (move == OUTER_GYRO_POSITIVE) ? outerGyroIndex() : move;
+}
+
+static std::array<uint8_t, HISTORY_CODES> findInverses() {
+    std::array<uint8_t, HISTORY_CODES> inverses;
+    for (int i = 0; i < HISTORY_CODES; i++) {
+        inverses[i] = MoveHistory::encodeMove(MoveHistory::getOpposite(MoveHistory::decodeMove(i)));
+    }
+    return inverses;
+}
+
+static uint8_t inverseMove(uint8_t move) {
+    static const std::array<uint8_t, HISTORY_CODES> inverses = findInverses();
+    return inverses[move];
+}
+
+uint8_t MoveHistory::encodeMove(const MoveEntry& entry) {
+    if (entry.type == GYRO_OUTER && entry.location > 0) {
+        return OUTER_GYRO_POSITIVE;
+    }
+    return MoveTable::get().moveIndex(entry);
+}
+
+MoveEntry MoveHistory::decodeMove(uint8_t move) {
+    MoveEntry entry = MoveTable::get().moveEntry(tableMove(move));
+    if (entry.type == GYRO_OUTER) {
+        entry.location = (move == OUTER_GYRO_POSITIVE) ? 1 : -1;
+    }
+    return entry;
+}
+
+void MoveHistory::pushMove(uint8_t move) {
+    history.push_back(move);
+    if (isTurn(move)) {
+        turnCount += 1;
+    }
+}
+
+// Looks back through moves that commute with this one, for its inverse or
+// enough copies of it to make a full rotation
+bool MoveHistory::cancelMove(uint8_t move) {
+    const MoveTable& table = MoveTable::get();
+    uint8_t inverse = inverseMove(move);
+    int order = table.getOrder(tableMove(move));
+    std::vector<size_t> copies;
+    size_t end = (history.size() > NORMALISE_WINDOW) ? history.size() - NORMALISE_WINDOW : 0;
+    for (size_t i = history.size(); i-- > end;) {
+        if (history[i] == inverse) {
+            copies.assign(1, i);
+            break;
+        }
+        if (history[i] == move) {
+            copies.push_back(i);
+            if (order && (int)copies.size() == order - 1) break;
+        } else if (!table.commutes(tableMove(history[i]), tableMove(move))) {
+            return false;
+        }
+    }
+    bool complete = copies.size() && (history[copies[0]] == inverse || (order && (int)copies.size() == order - 1));
+    if (!complete) return false;
+    // Indices are in descending order
+    invalidate(copies.back());
+    for (size_t i = 0; i < copies.size(); i++) {
+        history.erase(history.begin() + copies[i]);
+        if (isTurn(move)) {
+            turnCount -= 1;
+        }
+    }
+    return true;
+}
+
+void MoveHistory::normalise() {
+    std::vector<uint8_t> moves;
+    moves.swap(history);
+    turnCount = 0;
+    invalidate(0);
+    for (size_t i = 0; i < moves.size(); i++) {
+        if (!cancelMove(moves[i])) {
+            pushMove(moves[i]);
+        }
+    }
+}
+
+void MoveHistory::insertMove(MoveEntry entry) {
+    uint8_t move = encodeMove(entry);
+    if (undoing) {
+        if (isTurn(move)) {
+            turnCount -= 1;
+        }
+        undoing = false;
+    } else if (history.size() && history.back() == inverseMove(move)) {
+        redoList.push_back(history.back());
+        history.pop_back();
+        if (isTurn(move)) {
+            turnCount -= 1;
+        }
+    } else if (normalising && !redoing && cancelMove(move)) {
+        redoList.clear();
+    } else {
+        if (!redoing) {
+            redoList.clear();
+            invalidate(history.size());
+        } else {
+            redoing = false;
+        }
+        pushMove(move);
+    }
+}
+
+bool MoveHistory::undoMove(MoveEntry *entry) {
+    if (!history.size()) {
+        return false;
+    }
+    uint8_t lastMove = history.back();
+    *entry = decodeMove(inverseMove(lastMove));
+    undoing = true;
+    redoList.push_back(lastMove);
+    history.pop_back();
+    return true;
+}
+
+bool MoveHistory::redoMove(MoveEntry *entry) {
+    if (!redoList.size()) {
+        return false;
+    }
+    *entry = decodeMove(redoList.back());
+    redoList.pop_back();
+    redoing = true;
+    return true;
+}
+
+bool MoveHistory::canUndo() {
+    return history.size() > 0;
+}
+
+bool MoveHistory::canRedo() {
+    return redoList.size() > 0;
+}
+
+int MoveHistory::getTurnCount() {
+    return turnCount;
+}
+
+std::vector<MoveEntry> MoveHistory::getMoves() {
+    std::vector<MoveEntry> moves;
+    moves.reserve(history.size());
+    for (size_t i = 0; i < history.size(); i++) {
+        moves.push_back(decodeMove(history[i]));
+    }
+    return moves;
+}
+
+size_t MoveHistory::getMoveCount() {
+    return history.size();
+}
+
+MoveEntry MoveHistory::getMove(size_t index) {
+    return decodeMove(history[index]);
+}
+
+bool MoveHistory::isNormalising() {
+    return normalising;
+}
+
+void MoveHistory::setNormalising(bool normalising) {
+    this->normalising = normalising;
+    if (normalising) {
+        normalise();
+    }
+}
+
+void MoveHistory::setStart(const PackedPuzzle& start) {
+    checkpoints.assign(1, start);
+}
+
+size_t MoveHistory::getLength() {
+    return history.size() + redoList.size();
+}
+
+MoveEntry MoveHistory::getTimelineMove(size_t index) {
+    if (index < history.size()) {
+        return decodeMove(history[index]);
+    }
+    return decodeMove(redoList[redoList.size() - 1 - (index - history.size())]);
+}
+
+size_t MoveHistory::getCheckpointCount() {
+    return checkpoints.size();
+}
+
+const PackedPuzzle& MoveHistory::getCheckpoint(size_t index) {
+    return checkpoints[index];
+}
+
+void MoveHistory::addCheckpoint(const PackedPuzzle& state) {
+    checkpoints.push_back(state);
+}
+
+void MoveHistory::seek(size_t index) {
+    while (history.size() > index) {
+        if (isTurn(history.back())) {
+            turnCount -= 1;
+        }
+        redoList.push_back(history.back());
+        history.pop_back();
+    }
+    while (history.size() < index && redoList.size()) {
+        pushMove(redoList.back());
+        redoList.pop_back();
+    }
+    undoing = false;
+    redoing = false;
+}
+
+void MoveHistory::invalidate(size_t index) {
+    size_t valid = index / CHECKPOINT_INTERVAL + 1;
+    if (checkpoints.size() > valid) {
+        checkpoints.erase(checkpoints.begin() + valid, checkpoints.end());
+    }
+}
+
+bool isOppositeParity(int a, int b) {
+    return a / 2 == b / 2 && a % 2 == 1 - b % 2;
+}
+
+int getOppositeParity(int a) {
+    return a / 2 * 2 + (1 - a % 2);
+}
+
+bool MoveHistory::isOpposite(MoveEntry entry1, MoveEntry entry2) {
+    if (entry1.type != entry2.type) {
+        return false;
+    }
+    switch (entry1.type) {
+        case GYRO:
+            return isOppositeParity((int)entry1.cell, (int)entry2.cell);
+        case TURN:
+            return entry1.cell == entry2.cell && isOppositeParity((int)entry1.direction, (int)entry2.direction);
+        case ROTATE:
+            return isOppositeParity((int)entry1.direction, (int)entry2.direction);
+        case GYRO_OUTER:
+            return entry1.location == -entry2.location;
+        case GYRO_MIDDLE:
+            return entry1.location == -entry2.location;
+        default:
+            // should not run
+            return false;
+    }
+}
+
+MoveEntry MoveHistory::getOpposite(MoveEntry entry) {
+    MoveEntry opposite;
+    opposite.type = entry.type;
+    opposite.animLength = entry.animLength;
+    switch (entry.type) {
+        case GYRO:
+            opposite.cell = (CellLocation)getOppositeParity((int)entry.cell);
+            break;
+        case TURN:
+            opposite.cell = entry.cell;
+            opposite.direction = (RotateDirection)getOppositeParity((int)entry.direction);
+            break;
+        case ROTATE:
+            opposite.direction = (RotateDirection)getOppositeParity((int)entry.direction);
+            break;
+        case GYRO_OUTER:
+            opposite.location = -entry.location;
+            break;
+        case GYRO_MIDDLE:
+            opposite.location = -entry.location;
+            break;
+    }
+    return opposite;
+}
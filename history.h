@@ -0,0 +1,86 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <vector>
+#include <cstdint>
+#include "move.h"
+#include "packed.h"
+
+// MoveTable indices, plus one for outer gyros towards +1
+#define OUTER_GYRO_POSITIVE 36
+#define HISTORY_CODES 37
+// Moves searched back through for a cancellation
+#define NORMALISE_WINDOW 64
+// Moves between stored puzzle states
+#define CHECKPOINT_INTERVAL 128
+
+// Moves are stored as one byte each
+class MoveHistory {
+    public:
+        MoveHistory();
+        void reset();
+        void insertMove(MoveEntry entry);
+        static bool isOpposite(MoveEntry entry1, MoveEntry entry2);
+        static MoveEntry getOpposite(MoveEntry entry);
+        bool undoMove(MoveEntry* entry);
+        bool redoMove(MoveEntry* entry);
+        bool canUndo();
+        bool canRedo();
+        int getTurnCount();
+        // Moves that have not been undone, oldest first
+        std::vector<MoveEntry> getMoves();
+        size_t getMoveCount();
+        MoveEntry getMove(size_t index);
+        // Cancels moves against earlier ones they commute with, and full rotations
+        bool isNormalising();
+        void setNormalising(bool normalising);
+
+        // Moves are indexed from the start state, through history then the redo list
+        void setStart(const PackedPuzzle& start);
+        size_t getLength();
+        MoveEntry getTimelineMove(size_t index);
+        // State after every CHECKPOINT_INTERVAL moves, filled in by whoever seeks
+        size_t getCheckpointCount();
+        const PackedPuzzle& getCheckpoint(size_t index);
+        void addCheckpoint(const PackedPuzzle& state);
+        // Undoes or redoes without animation until index moves are done
+        void seek(size_t index);
+
+        static uint8_t encodeMove(const MoveEntry& entry);
+        static MoveEntry decodeMove(uint8_t move);
+
+    private:
+        int turnCount;
+        std::vector<uint8_t> history;
+        std::vector<uint8_t> redoList;
+        bool undoing;
+        bool redoing;
+        bool normalising;
+        std::vector<PackedPuzzle> checkpoints;
+
+        void pushMove(uint8_t move);
+        bool cancelMove(uint8_t move);
+        void normalise();
+        // Drops checkpoints past a changed move
+        void invalidate(size_t index);
+};
+
+#endif // history.h
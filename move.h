@@ -0,0 +1,37 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+
+#ifndef MOVE_H
+#define MOVE_H
+
+#include "puzzle.h"
+
+typedef enum {
+    GYRO, TURN, ROTATE, GYRO_OUTER, GYRO_MIDDLE
+} MoveType;
+
+struct MoveEntry {
+    MoveType type;
+    float animLength;
+    CellLocation cell; // for GYRO, TURN
+    RotateDirection direction; // for TURN
+    int location; // for slice gyros (-1/0/1 for middle gyros)
+};
+
+#endif // move.h
@@ -0,0 +1,255 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+
+#include "movetable.h"
+#include <algorithm>
+#include <random>
+
+static MoveEntry makeEntry(MoveType type, float animLength, CellLocation cell, RotateDirection direction, int location) {
+    MoveEntry entry;
+    entry.type = type;
+    entry.animLength = animLength;
+    entry.cell = cell;
+    entry.direction = direction;
+    entry.location = location;
+    return entry;
+}
+
+const MoveTable& MoveTable::get() {
+    static MoveTable table;
+    return table;
+}
+
+bool MoveTable::canApply(const Puzzle& puzzle, const MoveEntry& entry) {
+    // Mirrors the preconditions PuzzleController sets up before each move
+    switch (entry.type) {
+        case TURN:
+            if (entry.cell == UP || entry.cell == DOWN) {
+                if (puzzle.middleSliceDir != UP) return false;
+            } else if (entry.cell == FRONT || entry.cell == BACK) {
+                if (puzzle.middleSliceDir != FRONT) return false;
+            }
+            return puzzle.canRotateCell(entry.cell, entry.direction);
+        case ROTATE:
+            return puzzle.canRotatePuzzle(entry.direction);
+        case GYRO:
+            if (entry.cell == UP || entry.cell == DOWN) {
+                return puzzle.middleSliceDir == UP && puzzle.middleSlicePos == puzzle.outerSlicePos;
+            } else if (entry.cell == FRONT || entry.cell == BACK) {
+                return puzzle.middleSliceDir == FRONT && puzzle.middleSlicePos == puzzle.outerSlicePos;
+            }
+            return entry.cell == LEFT || entry.cell == RIGHT;
+        case GYRO_OUTER:
+            return true;
+        case GYRO_MIDDLE:
+            return entry.location == 0 || puzzle.canGyroMiddle(entry.location);
+    }
+    return false;
+}
+
+void MoveTable::applyToPuzzle(Puzzle& puzzle, const MoveEntry& entry) {
+    switch (entry.type) {
+        case TURN: puzzle.rotateCell(entry.cell, entry.direction); break;
+        case ROTATE: puzzle.rotatePuzzle(entry.direction); break;
+        case GYRO: puzzle.gyroCell(entry.cell); break;
+        case GYRO_OUTER: puzzle.gyroOuterSlice(); break;
+        case GYRO_MIDDLE: puzzle.gyroMiddleSlice(entry.location); break;
+    }
+}
+
+MoveTable::MoveTable() {
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 6; j++) {
+            turnIndex[i][j] = -1;
+        }
+    }
+
+    Puzzle puzzle;
+    for (int i = 0; i < 8; i++) {
+        CellLocation cell = (CellLocation)i;
+        float length = (cell == UP || cell == DOWN || cell == FRONT || cell == BACK) ? 2.0f : 1.0f;
+        for (int j = 0; j < 6; j++) {
+            if (!puzzle.canRotateCell(cell, (RotateDirection)j)) continue;
+            turnIndex[i][j] = moves.size();
+            moves.push_back(makeEntry(TURN, length, cell, (RotateDirection)j, 0));
+        }
+    }
+    moves.push_back(makeEntry(ROTATE, 1.0f, IN, ZY, 0));
+    moves.push_back(makeEntry(ROTATE, 1.0f, IN, YZ, 0));
+    for (int i = RIGHT; i <= BACK; i++) {
+        CellLocation cell = (CellLocation)i;
+        moves.push_back(makeEntry(GYRO, (cell == LEFT || cell == RIGHT) ? 4.0f : 3.0f, cell, ZY, 0));
+    }
+    moves.push_back(makeEntry(GYRO_OUTER, 2.0f, IN, ZY, 0));
+    for (int i = -1; i < 2; i++) {
+        moves.push_back(makeEntry(GYRO_MIDDLE, 1.0f, IN, ZY, i));
+    }
+
+    // Label every sticker with its own index, the move then reveals where each one came from
+    for (int move = 0; move < MOVE_COUNT; move++) {
+        for (int config = 0; config < CONFIG_COUNT; config++) {
+            Puzzle labelled;
+            labelled.hashed = false;
+            PackedPuzzle::decodeConfig(config, labelled.outerSlicePos, labelled.middleSlicePos, labelled.middleSliceDir);
+            if (!canApply(labelled, moves[move])) {
+                permutationIndex[move][config] = 0;
+                nextConfig[move][config] = ILLEGAL_CONFIG;
+                continue;
+            }
+            std::array<Color*, STICKER_COUNT> stickers = PackedPuzzle::stickerPointers(labelled);
+            for (int i = 0; i < STICKER_COUNT; i++) {
+                *stickers[i] = (Color)i;
+            }
+            applyToPuzzle(labelled, moves[move]);
+
+            std::array<uint8_t, STICKER_COUNT> permutation;
+            for (int i = 0; i < STICKER_COUNT; i++) {
+                permutation[i] = (uint8_t)*stickers[i];
+            }
+            // Permutations rarely depend on the configuration, share identical ones
+            size_t index = 0;
+            while (index < permutations.size() && permutations[index] != permutation) index++;
+            if (index == permutations.size()) permutations.push_back(permutation);
+            permutationIndex[move][config] = index;
+            nextConfig[move][config] = PackedPuzzle::puzzleConfig(labelled);
+        }
+    }
+    findCommutingMoves();
+    findOrders();
+}
+
+// result[i] = state[first[second[i]]], first then second
+static void compose(const uint8_t *first, const uint8_t *second, uint8_t *result) {
+    for (int i = 0; i < STICKER_COUNT; i++) {
+        result[i] = first[second[i]];
+    }
+}
+
+void MoveTable::findCommutingMoves() {
+    uint8_t forward[STICKER_COUNT], backward[STICKER_COUNT];
+    for (int a = 0; a < MOVE_COUNT; a++) {
+        commuteMask[a] = 0;
+    }
+    for (int a = 0; a < MOVE_COUNT; a++) {
+        for (int b = a; b < MOVE_COUNT; b++) {
+            bool commuting = true;
+            for (int config = 0; config < CONFIG_COUNT && commuting; config++) {
+                int afterA = nextConfig[a][config];
+                int afterB = nextConfig[b][config];
+                int afterAB = (afterA == ILLEGAL_CONFIG) ? ILLEGAL_CONFIG : nextConfig[b][afterA];
+                int afterBA = (afterB == ILLEGAL_CONFIG) ? ILLEGAL_CONFIG : nextConfig[a][afterB];
+                if (afterAB != afterBA) {
+                    commuting = false;
+                } else if (afterAB != ILLEGAL_CONFIG) {
+                    compose(getPermutation(a, config), getPermutation(b, afterA), forward);
+                    compose(getPermutation(b, config), getPermutation(a, afterB), backward);
+                    commuting = std::equal(forward, forward + STICKER_COUNT, backward);
+                }
+            }
+            if (commuting) {
+                commuteMask[a] |= (uint64_t)1 << b;
+                commuteMask[b] |= (uint64_t)1 << a;
+            }
+        }
+    }
+}
+
+void MoveTable::findOrders() {
+    uint8_t state[STICKER_COUNT], next[STICKER_COUNT];
+    for (int move = 0; move < MOVE_COUNT; move++) {
+        moveOrder[move] = 0;
+        for (int order = 1; order <= 4 && !moveOrder[move]; order++) {
+            bool identity = true;
+            for (int config = 0; config < CONFIG_COUNT && identity; config++) {
+                if (nextConfig[move][config] == ILLEGAL_CONFIG) continue;
+                for (int i = 0; i < STICKER_COUNT; i++) {
+                    state[i] = i;
+                }
+                int current = config;
+                for (int i = 0; i < order && current != ILLEGAL_CONFIG; i++) {
+                    compose(state, getPermutation(move, current), next);
+                    std::copy(next, next + STICKER_COUNT, state);
+                    current = nextConfig[move][current];
+                }
+                if (current != config) {
+                    identity = false;
+                } else {
+                    for (int i = 0; i < STICKER_COUNT && identity; i++) {
+                        identity = state[i] == i;
+                    }
+                }
+            }
+            if (identity) moveOrder[move] = order;
+        }
+    }
+}
+
+int MoveTable::moveIndex(const MoveEntry& entry) const {
+    switch (entry.type) {
+        case TURN: return turnIndex[entry.cell][entry.direction];
+        case ROTATE: return 24 + (entry.direction == YZ);
+        case GYRO: return (entry.cell >= RIGHT) ? 26 + entry.cell - RIGHT : -1;
+        case GYRO_OUTER: return 32;
+        case GYRO_MIDDLE: return 34 + entry.location;
+    }
+    return -1;
+}
+
+const MoveEntry& MoveTable::moveEntry(int move) const {
+    return moves[move];
+}
+
+const uint8_t* MoveTable::getPermutation(int move, int config) const {
+    return permutations[permutationIndex[move][config]].data();
+}
+
+int MoveTable::getNextConfig(int move, int config) const {
+    return nextConfig[move][config];
+}
+
+bool MoveTable::commutes(int move1, int move2) const {
+    return (commuteMask[move1] >> move2) & 1;
+}
+
+int MoveTable::getOrder(int move) const {
+    return moveOrder[move];
+}
+
+bool MoveTable::apply(PackedPuzzle& state, int move) const {
+    int config = state.getConfig();
+    if (nextConfig[move][config] == ILLEGAL_CONFIG) return false;
+    state.applyPermutation(getPermutation(move, config));
+    state.setConfig(nextConfig[move][config]);
+    return true;
+}
+
+bool MoveTable::verify(int count, unsigned int seed) const {
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> distribution(0, MOVE_COUNT - 1);
+    Puzzle puzzle;
+    PackedPuzzle state(puzzle);
+    for (int i = 0; i < count; i++) {
+        int move = distribution(generator);
+        if (!canApply(puzzle, moves[move])) continue;
+        applyToPuzzle(puzzle, moves[move]);
+        apply(state, move);
+        if (state != PackedPuzzle(puzzle)) return false;
+    }
+    return true;
+}
@@ -0,0 +1,67 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+
+#ifndef MOVETABLE_H
+#define MOVETABLE_H
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include "move.h"
+#include "packed.h"
+
+// 24 turns, 2 rotations, 6 gyros, the outer gyro and 3 middle gyros
+#define MOVE_COUNT 36
+#define ILLEGAL_CONFIG 0xFF
+
+// Sticker permutations for every move, recorded from Puzzle's own move functions
+class MoveTable {
+    public:
+        static const MoveTable& get();
+        int moveIndex(const MoveEntry& entry) const;
+        const MoveEntry& moveEntry(int move) const;
+        const uint8_t* getPermutation(int move, int config) const;
+        // ILLEGAL_CONFIG if the move cannot be made from this configuration
+        int getNextConfig(int move, int config) const;
+        bool apply(PackedPuzzle& state, int move) const;
+        // Same legality and result in either order from every configuration
+        bool commutes(int move1, int move2) const;
+        // Repeats that return every configuration to where it started, 0 if more than 4
+        int getOrder(int move) const;
+        // Compare table moves against Puzzle over a random walk
+        bool verify(int moves, unsigned int seed) const;
+
+        static bool canApply(const Puzzle& puzzle, const MoveEntry& entry);
+        static void applyToPuzzle(Puzzle& puzzle, const MoveEntry& entry);
+
+    private:
+        MoveTable();
+        std::vector<MoveEntry> moves;
+        std::vector<std::array<uint8_t, STICKER_COUNT>> permutations;
+        uint8_t permutationIndex[MOVE_COUNT][CONFIG_COUNT];
+        uint8_t nextConfig[MOVE_COUNT][CONFIG_COUNT];
+        int8_t turnIndex[8][6];
+        uint64_t commuteMask[MOVE_COUNT];
+        uint8_t moveOrder[MOVE_COUNT];
+
+        void findCommutingMoves();
+        void findOrders();
+};
+
+#endif // movetable.h
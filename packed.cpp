@@ -0,0 +1,172 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+
+#include "packed.h"
+#include <algorithm>
+
+template <typename Visit>
+void PackedPuzzle::forEachPiece(Puzzle& puzzle, Visit visit) {
+    // Pieces have one sticker plus one per axis away from the centre
+    CellData *cells[2] = {&puzzle.leftCell, &puzzle.rightCell};
+    for (int c = 0; c < 2; c++) {
+        for (int x = 0; x < 3; x++) {
+            for (int y = 0; y < 3; y++) {
+                for (int z = 0; z < 3; z++) {
+                    visit((*cells[c])[x][y][z], 1 + (x != 1) + (y != 1) + (z != 1));
+                }
+            }
+        }
+    }
+    SliceData *slices[2] = {&puzzle.innerSlice, &puzzle.outerSlice};
+    for (int s = 0; s < 2; s++) {
+        for (int y = 0; y < 3; y++) {
+            for (int z = 0; z < 3; z++) {
+                visit((*slices[s])[y][z], 1 + (y != 1) + (z != 1));
+            }
+        }
+    }
+    visit(puzzle.topCell, 1);
+    visit(puzzle.bottomCell, 1);
+    for (int i = 0; i < 3; i++) {
+        visit(puzzle.frontCell[i], (i == 1) ? 1 : 2);
+    }
+    for (int i = 0; i < 3; i++) {
+        visit(puzzle.backCell[i], (i == 1) ? 1 : 2);
+    }
+}
+
+std::array<Color*, STICKER_COUNT> PackedPuzzle::stickerPointers(Puzzle& puzzle) {
+    std::array<Color*, STICKER_COUNT> stickers;
+    int index = 0;
+    forEachPiece(puzzle, [&](Piece& piece, int count) {
+        Color *colors[4] = {&piece.a, &piece.b, &piece.c, &piece.d};
+        for (int i = 0; i < count; i++) {
+            stickers[index++] = colors[i];
+        }
+    });
+    return stickers;
+}
+
+std::vector<int> PackedPuzzle::pieceSizes() {
+    std::vector<int> sizes;
+    Puzzle puzzle;
+    forEachPiece(puzzle, [&](Piece& piece, int count) {
+        sizes.push_back(count);
+    });
+    return sizes;
+}
+
+int PackedPuzzle::encodeConfig(int outerSlicePos, int middleSlicePos, CellLocation middleSliceDir) {
+    int lowest = (outerSlicePos == 1) ? -1 : -2;
+    return ((outerSlicePos == 1) ? 0 : 8) + (middleSlicePos - lowest) * 2 + ((middleSliceDir == UP) ? 1 : 0);
+}
+
+void PackedPuzzle::decodeConfig(int config, int& outerSlicePos, int& middleSlicePos, CellLocation& middleSliceDir) {
+    outerSlicePos = (config < 8) ? 1 : -1;
+    middleSlicePos = (config % 8) / 2 + ((outerSlicePos == 1) ? -1 : -2);
+    middleSliceDir = (config % 2) ? UP : FRONT;
+}
+
+int PackedPuzzle::puzzleConfig(const Puzzle& puzzle) {
+    return encodeConfig(puzzle.outerSlicePos, puzzle.middleSlicePos, puzzle.middleSliceDir);
+}
+
+PackedPuzzle::PackedPuzzle() : PackedPuzzle(Puzzle()) {}
+
+PackedPuzzle::PackedPuzzle(const Puzzle& puzzle) {
+    // Pointers are only read from here
+    std::array<Color*, STICKER_COUNT> pointers = stickerPointers(const_cast<Puzzle&>(puzzle));
+    uint8_t stickers[STICKER_COUNT];
+    for (int i = 0; i < STICKER_COUNT; i++) {
+        stickers[i] = (uint8_t)*pointers[i];
+    }
+    pack(stickers);
+    config = puzzleConfig(puzzle);
+}
+
+void PackedPuzzle::toPuzzle(Puzzle& puzzle) const {
+    // Reset first so unused sticker slots are consistent
+    puzzle.resetPuzzle();
+    std::array<Color*, STICKER_COUNT> pointers = stickerPointers(puzzle);
+    uint8_t stickers[STICKER_COUNT];
+    unpack(stickers);
+    for (int i = 0; i < STICKER_COUNT; i++) {
+        *pointers[i] = (Color)stickers[i];
+    }
+    decodeConfig(config, puzzle.outerSlicePos, puzzle.middleSlicePos, puzzle.middleSliceDir);
+    puzzle.rehash();
+}
+
+Color PackedPuzzle::getSticker(int index) const {
+    int shift = (index % STICKERS_PER_WORD) * 3;
+    return (Color)((words[index / STICKERS_PER_WORD] >> shift) & 7);
+}
+
+void PackedPuzzle::setSticker(int index, Color color) {
+    int shift = (index % STICKERS_PER_WORD) * 3;
+    uint64_t& word = words[index / STICKERS_PER_WORD];
+    word = (word & ~((uint64_t)7 << shift)) | ((uint64_t)color << shift);
+}
+
+int PackedPuzzle::getConfig() const {
+    return config;
+}
+
+void PackedPuzzle::setConfig(int config) {
+    this->config = config;
+}
+
+void PackedPuzzle::applyPermutation(const uint8_t *permutation) {
+    uint8_t stickers[STICKER_COUNT], permuted[STICKER_COUNT];
+    unpack(stickers);
+    for (int i = 0; i < STICKER_COUNT; i++) {
+        permuted[i] = stickers[permutation[i]];
+    }
+    pack(permuted);
+}
+
+bool PackedPuzzle::operator==(const PackedPuzzle& other) const {
+    return config == other.config && words == other.words;
+}
+
+bool PackedPuzzle::operator!=(const PackedPuzzle& other) const {
+    return !(*this == other);
+}
+
+void PackedPuzzle::unpack(uint8_t *stickers) const {
+    for (int w = 0; w < PACKED_WORDS; w++) {
+        uint64_t word = words[w];
+        int count = std::min(STICKERS_PER_WORD, STICKER_COUNT - w * STICKERS_PER_WORD);
+        for (int i = 0; i < count; i++) {
+            stickers[w * STICKERS_PER_WORD + i] = word & 7;
+            word >>= 3;
+        }
+    }
+}
+
+void PackedPuzzle::pack(const uint8_t *stickers) {
+    for (int w = 0; w < PACKED_WORDS; w++) {
+        uint64_t word = 0;
+        int count = std::min(STICKERS_PER_WORD, STICKER_COUNT - w * STICKERS_PER_WORD);
+        for (int i = count - 1; i >= 0; i--) {
+            word = (word << 3) | stickers[w * STICKERS_PER_WORD + i];
+        }
+        words[w] = word;
+    }
+}
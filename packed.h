@@ -0,0 +1,68 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+
+#ifndef PACKED_H
+#define PACKED_H
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include "puzzle.h"
+
+// Sticker stored in 3 bits, 21 per word so none straddle a boundary
+#define STICKER_COUNT 216
+#define STICKERS_PER_WORD 21
+#define PACKED_WORDS ((STICKER_COUNT + STICKERS_PER_WORD - 1) / STICKERS_PER_WORD)
+// outerSlicePos x middleSlicePos x middleSliceDir
+#define CONFIG_COUNT 16
+
+// Compact copy of a Puzzle state, stickers are ordered by stickerPointers
+class PackedPuzzle {
+    public:
+        PackedPuzzle();
+        explicit PackedPuzzle(const Puzzle& puzzle);
+        void toPuzzle(Puzzle& puzzle) const;
+        Color getSticker(int index) const;
+        void setSticker(int index, Color color);
+        int getConfig() const;
+        void setConfig(int config);
+        // new[i] = old[permutation[i]]
+        void applyPermutation(const uint8_t *permutation);
+        bool operator==(const PackedPuzzle& other) const;
+        bool operator!=(const PackedPuzzle& other) const;
+
+        // Every used sticker of the puzzle, in packing order
+        static std::array<Color*, STICKER_COUNT> stickerPointers(Puzzle& puzzle);
+        // Stickers in each piece, pieces are consecutive in packing order
+        static std::vector<int> pieceSizes();
+        static int encodeConfig(int outerSlicePos, int middleSlicePos, CellLocation middleSliceDir);
+        static void decodeConfig(int config, int& outerSlicePos, int& middleSlicePos, CellLocation& middleSliceDir);
+        static int puzzleConfig(const Puzzle& puzzle);
+
+    private:
+        std::array<uint64_t, PACKED_WORDS> words;
+        uint8_t config;
+
+        void unpack(uint8_t *stickers) const;
+        void pack(const uint8_t *stickers);
+        template <typename Visit>
+        static void forEachPiece(Puzzle& puzzle, Visit visit);
+};
+
+#endif // packed.h
@@ -0,0 +1,379 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+#include "patterns.h"
+#include "movetable.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <thread>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Frontier entries handed to a thread at a time
+#define PATTERN_CHUNK 16384
+
+static PieceLayout findLayout() {
+    PieceLayout layout;
+    layout.pieceSize = PackedPuzzle::pieceSizes();
+    int start = 0;
+    for (size_t i = 0; i < layout.pieceSize.size(); i++) {
+        int size = layout.pieceSize[i];
+        layout.pieceStart.push_back(start);
+        layout.sizeRank.push_back((int)layout.sizePieces[size].size());
+        layout.sizePieces[size].push_back((int)i);
+        for (int j = 0; j < size; j++) {
+            layout.slotPiece[start + j] = (uint8_t)i;
+            layout.slotOffset[start + j] = (uint8_t)j;
+        }
+        start += size;
+    }
+    return layout;
+}
+
+const PieceLayout& PieceLayout::get() {
+    static const PieceLayout layout = findLayout();
+    return layout;
+}
+
+TrackedPiece PieceLayout::trackPiece(int piece) const {
+    TrackedPiece tracked;
+    tracked.count = std::min(pieceSize[piece], TRACKED_STICKERS);
+    for (int i = 0; i < TRACKED_STICKERS; i++) {
+        tracked.home[i] = (i < tracked.count) ? (uint8_t)(pieceStart[piece] + i) : 0;
+    }
+    return tracked;
+}
+
+// Ordered choices of tracked sticker offsets within a piece of each size
+typedef std::array<std::vector<std::array<uint8_t, TRACKED_STICKERS>>, 5> Arrangements;
+
+static Arrangements findArrangements() {
+    Arrangements arrangements;
+    for (int size = 1; size <= 4; size++) {
+        int count = std::min(size, TRACKED_STICKERS);
+        for (int a = 0; a < size; a++) {
+            for (int b = 0; b < ((count > 1) ? size : 1); b++) {
+                for (int c = 0; c < ((count > 2) ? size : 1); c++) {
+                    if (count > 1 && b == a) continue;
+                    if (count > 2 && (c == a || c == b)) continue;
+                    std::array<uint8_t, TRACKED_STICKERS> offsets = {{(uint8_t)a, (uint8_t)b, (uint8_t)c}};
+                    arrangements[size].push_back(offsets);
+                }
+            }
+        }
+    }
+    return arrangements;
+}
+
+static const Arrangements& arrangements() {
+    static const Arrangements found = findArrangements();
+    return found;
+}
+
+static int arrangementIndex(int size, const uint8_t *offsets) {
+    const std::vector<std::array<uint8_t, TRACKED_STICKERS>>& choices = arrangements()[size];
+    int count = std::min(size, TRACKED_STICKERS);
+    for (size_t i = 0; i < choices.size(); i++) {
+        if (std::equal(offsets, offsets + count, choices[i].begin())) return (int)i;
+    }
+    return 0;
+}
+
+PatternIndexer::PatternIndexer(const std::vector<TrackedPiece>& pieces) : pieces(pieces) {
+    const PieceLayout& layout = PieceLayout::get();
+    entries = CONFIG_COUNT;
+    for (size_t i = 0; i < pieces.size(); i++) {
+        int size = layout.pieceSize[layout.slotPiece[pieces[i].home[0]]];
+        radix.push_back(layout.sizePieces[size].size() * arrangements()[size].size());
+        entries *= radix.back();
+    }
+}
+
+uint64_t PatternIndexer::getEntries() const {
+    return entries;
+}
+
+const std::vector<TrackedPiece>& PatternIndexer::getPieces() const {
+    return pieces;
+}
+
+uint64_t PatternIndexer::index(const uint8_t *positions, int config) const {
+    const PieceLayout& layout = PieceLayout::get();
+    uint64_t index = 0;
+    for (size_t i = 0; i < pieces.size(); i++) {
+        const uint8_t *tracked = &positions[i * TRACKED_STICKERS];
+        int piece = layout.slotPiece[tracked[0]];
+        int size = layout.pieceSize[piece];
+        uint8_t offsets[TRACKED_STICKERS];
+        for (int j = 0; j < TRACKED_STICKERS; j++) {
+            offsets[j] = layout.slotOffset[tracked[j]];
+        }
+        uint64_t local = (uint64_t)layout.sizeRank[piece] * arrangements()[size].size() + arrangementIndex(size, offsets);
+        index = index * radix[i] + local;
+    }
+    return index * CONFIG_COUNT + config;
+}
+
+void PatternIndexer::decode(uint64_t index, uint8_t *positions, int& config) const {
+    const PieceLayout& layout = PieceLayout::get();
+    config = (int)(index % CONFIG_COUNT);
+    index /= CONFIG_COUNT;
+    for (size_t i = pieces.size(); i-- > 0;) {
+        uint64_t local = index % radix[i];
+        index /= radix[i];
+        int size = layout.pieceSize[layout.slotPiece[pieces[i].home[0]]];
+        const std::vector<std::array<uint8_t, TRACKED_STICKERS>>& choices = arrangements()[size];
+        int piece = layout.sizePieces[size][local / choices.size()];
+        const std::array<uint8_t, TRACKED_STICKERS>& offsets = choices[local % choices.size()];
+        for (int j = 0; j < TRACKED_STICKERS; j++) {
+            positions[i * TRACKED_STICKERS + j] = (j < pieces[i].count) ? (uint8_t)(layout.pieceStart[piece] + offsets[j]) : 0;
+        }
+    }
+}
+
+// Workers take chunks of the table and expand the entries found at the current depth.
+// Every write in a layer stores the same value into an empty nibble, so a plain OR is enough
+static void expandLayer(const PatternIndexer& indexer, std::atomic<uint8_t> *data, int depth,
+                        std::atomic<uint64_t>& nextChunk, std::atomic<uint64_t>& found) {
+    const MoveTable& table = MoveTable::get();
+    uint64_t entries = indexer.getEntries();
+    size_t count = indexer.getPieces().size();
+    uint8_t value = (uint8_t)(depth + 1);
+    uint8_t nextValue = (uint8_t)(depth + 2);
+    uint8_t positions[PATTERN_MAX_PIECES * TRACKED_STICKERS];
+    uint8_t before[PATTERN_MAX_PIECES * TRACKED_STICKERS];
+    uint64_t added = 0;
+    uint64_t start;
+    while ((start = nextChunk.fetch_add(PATTERN_CHUNK)) < entries) {
+        uint64_t end = std::min(start + PATTERN_CHUNK, entries);
+        for (uint64_t entry = start; entry < end; entry++) {
+            if (((data[entry >> 1].load(std::memory_order_relaxed) >> ((entry & 1) * 4)) & 0xF) != value) continue;
+            int config;
+            indexer.decode(entry, positions, config);
+            for (int move = 0; move < MOVE_COUNT; move++) {
+                for (int previous = 0; previous < CONFIG_COUNT; previous++) {
+                    if (table.getNextConfig(move, previous) != config) continue;
+                    // The sticker now at slot p was at permutation[p] before the move
+                    const uint8_t *permutation = table.getPermutation(move, previous);
+                    for (size_t i = 0; i < count * TRACKED_STICKERS; i++) {
+                        before[i] = (i % TRACKED_STICKERS < (size_t)indexer.getPieces()[i / TRACKED_STICKERS].count) ? permutation[positions[i]] : 0;
+                    }
+                    uint64_t next = indexer.index(before, previous);
+                    int shift = (next & 1) * 4;
+                    if ((data[next >> 1].load(std::memory_order_relaxed) >> shift) & 0xF) continue;
+                    data[next >> 1].fetch_or((uint8_t)(nextValue << shift), std::memory_order_relaxed);
+                    added++;
+                }
+            }
+        }
+    }
+    found += added;
+}
+
+std::vector<uint8_t> generatePatterns(const PatternIndexer& indexer, int threads) {
+    uint64_t entries = indexer.getEntries();
+    uint64_t bytes = (entries + 1) / 2;
+    std::unique_ptr<std::atomic<uint8_t>[]> data(new std::atomic<uint8_t>[bytes]());
+
+    uint8_t home[PATTERN_MAX_PIECES * TRACKED_STICKERS];
+    for (size_t i = 0; i < indexer.getPieces().size(); i++) {
+        std::copy(indexer.getPieces()[i].home, indexer.getPieces()[i].home + TRACKED_STICKERS, &home[i * TRACKED_STICKERS]);
+    }
+    for (int config = 0; config < CONFIG_COUNT; config++) {
+        uint64_t index = indexer.index(home, config);
+        data[index >> 1].fetch_or((uint8_t)(1 << ((index & 1) * 4)));
+    }
+
+    threads = std::max(threads, 1);
+    for (int depth = 0; depth < PATTERN_MAX_DISTANCE; depth++) {
+        std::atomic<uint64_t> nextChunk(0), found(0);
+        std::vector<std::thread> running;
+        for (int i = 1; i < threads; i++) {
+            running.push_back(std::thread(expandLayer, std::cref(indexer), data.get(), depth, std::ref(nextChunk), std::ref(found)));
+        }
+        expandLayer(indexer, data.get(), depth, nextChunk, found);
+        for (size_t i = 0; i < running.size(); i++) {
+            running[i].join();
+        }
+        if (!found) break;
+    }
+
+    std::vector<uint8_t> packed(bytes);
+    for (uint64_t i = 0; i < bytes; i++) {
+        packed[i] = data[i].load();
+    }
+    return packed;
+}
+
+PatternFile::PatternFile() {
+    data = NULL;
+    size = 0;
+#ifdef _WIN32
+    file = NULL;
+    mapping = NULL;
+#endif
+}
+
+PatternFile::~PatternFile() {
+    close();
+}
+
+uint64_t PatternFile::moveChecksum() {
+    // FNV-1a over every permutation and configuration change
+    const MoveTable& table = MoveTable::get();
+    uint64_t hash = 14695981039346656037ULL;
+    for (int move = 0; move < MOVE_COUNT; move++) {
+        for (int config = 0; config < CONFIG_COUNT; config++) {
+            const uint8_t *permutation = table.getPermutation(move, config);
+            for (int i = 0; i <= STICKER_COUNT; i++) {
+                uint8_t byte = (i < STICKER_COUNT) ? permutation[i] : (uint8_t)table.getNextConfig(move, config);
+                hash = (hash ^ byte) * 1099511628211ULL;
+            }
+        }
+    }
+    return hash;
+}
+
+bool PatternFile::open(const std::string& filename) {
+    close();
+#if defined(__EMSCRIPTEN__)
+    return false;
+#else
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER length;
+    GetFileSizeEx(handle, &length);
+    HANDLE view = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (view == NULL) {
+        CloseHandle(handle);
+        return false;
+    }
+    file = handle;
+    mapping = view;
+    size = (size_t)length.QuadPart;
+    data = (const uint8_t*)MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+#else
+    int descriptor = ::open(filename.c_str(), O_RDONLY);
+    if (descriptor < 0) return false;
+    struct stat info;
+    if (fstat(descriptor, &info) != 0 || info.st_size == 0) {
+        ::close(descriptor);
+        return false;
+    }
+    size = (size_t)info.st_size;
+    void *mapped = mmap(NULL, size, PROT_READ, MAP_SHARED, descriptor, 0);
+    ::close(descriptor);
+    data = (mapped == MAP_FAILED) ? NULL : (const uint8_t*)mapped;
+#endif
+    if (data == NULL) {
+        close();
+        return false;
+    }
+
+    const PatternFileHeader *header = (const PatternFileHeader*)data;
+    bool valid = size >= sizeof(PatternFileHeader) &&
+        std::memcmp(header->magic, PATTERN_MAGIC, sizeof(PATTERN_MAGIC)) == 0 &&
+        header->version == PATTERN_VERSION && header->moveChecksum == moveChecksum() &&
+        size >= sizeof(PatternFileHeader) + header->tableCount * sizeof(PatternTableHeader);
+    for (uint32_t i = 0; valid && i < header->tableCount; i++) {
+        const PatternTableHeader& table = getHeader(i);
+        valid = table.bits == PATTERN_BITS && table.pieceCount <= PATTERN_MAX_PIECES &&
+            table.offset + (table.entries + 1) / 2 <= size;
+    }
+    if (!valid) {
+        close();
+    }
+    return valid;
+#endif
+}
+
+void PatternFile::close() {
+#if defined(_WIN32)
+    if (data) UnmapViewOfFile(data);
+    if (mapping) CloseHandle(mapping);
+    if (file) CloseHandle(file);
+    mapping = NULL;
+    file = NULL;
+#elif !defined(__EMSCRIPTEN__)
+    if (data) munmap((void*)data, size);
+#endif
+    data = NULL;
+    size = 0;
+}
+
+size_t PatternFile::getTableCount() const {
+    return data ? ((const PatternFileHeader*)data)->tableCount : 0;
+}
+
+const PatternTableHeader& PatternFile::getHeader(size_t table) const {
+    return ((const PatternTableHeader*)(data + sizeof(PatternFileHeader)))[table];
+}
+
+const uint8_t* PatternFile::getData(size_t table) const {
+    return data + getHeader(table).offset;
+}
+
+bool PatternFile::write(const std::string& filename, const std::vector<PatternIndexer>& indexers,
+                        const std::vector<std::vector<uint8_t>>& tables) {
+    std::ofstream file(filename, std::ios::binary);
+    if (file.fail()) return false;
+    PatternFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, PATTERN_MAGIC, sizeof(PATTERN_MAGIC));
+    header.version = PATTERN_VERSION;
+    header.tableCount = (uint32_t)indexers.size();
+    header.moveChecksum = moveChecksum();
+    file.write((const char*)&header, sizeof(header));
+
+    uint64_t offset = sizeof(PatternFileHeader) + indexers.size() * sizeof(PatternTableHeader);
+    for (size_t i = 0; i < indexers.size(); i++) {
+        PatternTableHeader table;
+        std::memset(&table, 0, sizeof(table));
+        const std::vector<TrackedPiece>& pieces = indexers[i].getPieces();
+        table.pieceCount = (uint32_t)pieces.size();
+        table.bits = PATTERN_BITS;
+        for (size_t j = 0; j < pieces.size(); j++) {
+            std::copy(pieces[j].home, pieces[j].home + TRACKED_STICKERS, table.home[j]);
+            table.counts[j] = (uint8_t)pieces[j].count;
+        }
+        table.entries = indexers[i].getEntries();
+        offset = (offset + PATTERN_ALIGN - 1) / PATTERN_ALIGN * PATTERN_ALIGN;
+        table.offset = offset;
+        offset += tables[i].size();
+        file.write((const char*)&table, sizeof(table));
+    }
+    for (size_t i = 0; i < tables.size(); i++) {
+        std::streamoff position = file.tellp();
+        std::streamoff aligned = (position + PATTERN_ALIGN - 1) / PATTERN_ALIGN * PATTERN_ALIGN;
+        for (; position < aligned; position++) file.put(0);
+        file.write((const char*)tables[i].data(), tables[i].size());
+    }
+    return !file.fail();
+}
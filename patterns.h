@@ -0,0 +1,125 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+#ifndef PATTERNS_H
+#define PATTERNS_H
+
+#include <array>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "packed.h"
+
+// Enough stickers to fix the orientation of any piece
+#define TRACKED_STICKERS 3
+#define PATTERN_MAX_PIECES 3
+#define PATTERN_MAGIC "3to4pdb"
+#define PATTERN_VERSION 1
+// Entries are distance + 1 in 4 bits, 0 for further than PATTERN_MAX_DISTANCE
+#define PATTERN_BITS 4
+#define PATTERN_MAX_DISTANCE 14
+#define PATTERN_ALIGN 64
+
+// A piece by where its tracked stickers belong
+typedef struct {
+    int count;
+    uint8_t home[TRACKED_STICKERS];
+} TrackedPiece;
+
+// Pieces of the packed sticker order, and the slots of each
+struct PieceLayout {
+    std::vector<int> pieceStart;
+    std::vector<int> pieceSize;
+    std::array<uint8_t, STICKER_COUNT> slotPiece;
+    std::array<uint8_t, STICKER_COUNT> slotOffset;
+    // Pieces of each size, and the rank of every piece among them
+    std::array<std::vector<int>, 5> sizePieces;
+    std::vector<int> sizeRank;
+
+    static const PieceLayout& get();
+    TrackedPiece trackPiece(int piece) const;
+};
+
+// Perfect index of where a few pieces are, with the slice configuration last
+class PatternIndexer {
+    public:
+        explicit PatternIndexer(const std::vector<TrackedPiece>& pieces);
+        uint64_t getEntries() const;
+        const std::vector<TrackedPiece>& getPieces() const;
+        // positions holds TRACKED_STICKERS slots per piece
+        uint64_t index(const uint8_t *positions, int config) const;
+        void decode(uint64_t index, uint8_t *positions, int& config) const;
+
+    private:
+        std::vector<TrackedPiece> pieces;
+        std::vector<uint64_t> radix;
+        uint64_t entries;
+};
+
+// Breadth-first search backwards from every piece at home, on this many threads
+std::vector<uint8_t> generatePatterns(const PatternIndexer& indexer, int threads);
+
+static inline int patternDistance(const uint8_t *data, uint64_t index) {
+    int value = (data[index >> 1] >> ((index & 1) * 4)) & 0xF;
+    return value ? value - 1 : PATTERN_MAX_DISTANCE + 1;
+}
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t tableCount;
+    // Tables are only valid for the move permutations they were built from
+    uint64_t moveChecksum;
+} PatternFileHeader;
+
+typedef struct {
+    uint32_t pieceCount;
+    uint32_t bits;
+    uint8_t home[PATTERN_MAX_PIECES][TRACKED_STICKERS];
+    uint8_t counts[PATTERN_MAX_PIECES];
+    uint64_t entries;
+    // From the start of the file, a multiple of PATTERN_ALIGN
+    uint64_t offset;
+} PatternTableHeader;
+
+// Pattern databases mapped read-only from disk, pages are only read when looked up
+class PatternFile {
+    public:
+        PatternFile();
+        ~PatternFile();
+        // False if missing, stale or not a pattern file
+        bool open(const std::string& filename);
+        void close();
+        size_t getTableCount() const;
+        const PatternTableHeader& getHeader(size_t table) const;
+        const uint8_t* getData(size_t table) const;
+
+        static bool write(const std::string& filename, const std::vector<PatternIndexer>& indexers,
+                          const std::vector<std::vector<uint8_t>>& tables);
+        static uint64_t moveChecksum();
+
+    private:
+        const uint8_t *data;
+        size_t size;
+#ifdef _WIN32
+        void *file;
+        void *mapping;
+#endif
+};
+
+#endif // patterns.h
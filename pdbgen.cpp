@@ -0,0 +1,73 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+#include "packed.h"
+#include "patterns.h"
+#include "puzzle.h"
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <set>
+#include <thread>
+
+// Usage: pdbgen [output] [cell]
+// Writes a table for each pair of corners in a cell, for every cell unless one is given
+
+int main(int argc, char *argv[]) {
+    std::string filename = (argc > 1) ? argv[1] : "patterns.pdb";
+    int onlyCell = (argc > 2) ? std::atoi(argv[2]) : -1;
+    const PieceLayout& layout = PieceLayout::get();
+    PackedPuzzle solved((Puzzle()));
+
+    std::set<std::pair<int, int>> pairs;
+    for (int cell = 0; cell < 8; cell++) {
+        if (onlyCell != -1 && cell != onlyCell) continue;
+        std::vector<int> corners;
+        for (size_t i = 0; i < layout.sizePieces[4].size(); i++) {
+            int piece = layout.sizePieces[4][i];
+            for (int j = 0; j < 4; j++) {
+                if (solved.getSticker(layout.pieceStart[piece] + j) == cell) corners.push_back(piece);
+            }
+        }
+        for (size_t i = 0; i + 1 < corners.size(); i += 2) {
+            pairs.insert(std::make_pair(corners[i], corners[i + 1]));
+        }
+    }
+
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<PatternIndexer> indexers;
+    std::vector<std::vector<uint8_t>> tables;
+    for (std::set<std::pair<int, int>>::iterator it = pairs.begin(); it != pairs.end(); it++) {
+        std::vector<TrackedPiece> pieces;
+        pieces.push_back(layout.trackPiece(it->first));
+        pieces.push_back(layout.trackPiece(it->second));
+        indexers.push_back(PatternIndexer(pieces));
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        tables.push_back(generatePatterns(indexers.back(), threads));
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Corners " << it->first << " and " << it->second << ": " << indexers.back().getEntries()
+                  << " entries in " << elapsed << "s" << std::endl;
+    }
+
+    if (!PatternFile::write(filename, indexers, tables)) {
+        std::cerr << "Could not write " << filename << std::endl;
+        return 1;
+    }
+    std::cout << "Wrote " << tables.size() << " tables to " << filename << std::endl;
+    return 0;
+}
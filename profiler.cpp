@@ -0,0 +1,225 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+#include <glad/gl.h>
+#include <algorithm>
+#include "profiler.h"
+
+// WebGL has no core timer queries, the extension is often disabled anyway
+#ifndef __EMSCRIPTEN__
+#define HAS_GPU_TIMER
+#endif
+
+const char *FrameProfiler::stageNames[STAGE_COUNT] = {
+    "Poll events", "updateMouse", "updatePuzzle", "renderPuzzle",
+    "checkOutline", "Resolve scene", "renderGui", "Swap buffers"
+};
+
+unsigned int FrameProfiler::drawCalls = 0;
+unsigned int FrameProfiler::uniformUploads = 0;
+unsigned int FrameProfiler::bufferUploads = 0;
+
+FrameProfiler& FrameProfiler::get() {
+    static FrameProfiler profiler;
+    return profiler;
+}
+
+FrameProfiler::FrameProfiler() {
+    enabled = false;
+    frameIndex = 0;
+    lastFrame = 0.0;
+    queryActive = false;
+    lastGpuTime = 0.0f;
+    lastDrawCalls = 0;
+    lastUniformUploads = 0;
+    lastBufferUploads = 0;
+    fontAtlasTime = 0.0f;
+    firstFrameTime = -1.0f;
+    std::fill(frameTimes, frameTimes + PROFILE_FRAMES, 0.0f);
+    std::fill(gpuTimes, gpuTimes + PROFILE_FRAMES, 0.0f);
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        stageStart[i] = 0.0;
+        currentStages[i] = 0.0f;
+        std::fill(stageTimes[i], stageTimes[i] + PROFILE_FRAMES, 0.0f);
+    }
+    for (int i = 0; i < GPU_QUERIES; i++) {
+        queries[i] = 0;
+        queryPending[i] = false;
+    }
+}
+
+bool FrameProfiler::isEnabled() {
+    return enabled;
+}
+
+void FrameProfiler::setEnabled(bool enabled) {
+    if (this->enabled == enabled) return;
+    this->enabled = enabled;
+    lastFrame = 0.0;
+#ifdef HAS_GPU_TIMER
+    if (enabled) {
+        glGenQueries(GPU_QUERIES, queries);
+    } else {
+        if (queryActive) glEndQuery(GL_TIME_ELAPSED);
+        glDeleteQueries(GPU_QUERIES, queries);
+    }
+#endif
+    queryActive = false;
+    for (int i = 0; i < GPU_QUERIES; i++) {
+        queryPending[i] = false;
+    }
+}
+
+void FrameProfiler::beginFrame() {
+    if (!enabled) return;
+#ifdef HAS_GPU_TIMER
+    // Results arrive a few frames late, skip a frame rather than stall on one
+    int slot = frameIndex % GPU_QUERIES;
+    if (queryPending[slot]) {
+        int available = 0;
+        glGetQueryObjectiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 elapsed;
+            glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &elapsed);
+            lastGpuTime = elapsed / 1e6f;
+            queryPending[slot] = false;
+        }
+    }
+    if (!queryPending[slot]) {
+        glBeginQuery(GL_TIME_ELAPSED, queries[slot]);
+        queryActive = true;
+    }
+#endif
+}
+
+void FrameProfiler::endFrame() {
+    if (!enabled) {
+        drawCalls = 0;
+        uniformUploads = 0;
+        bufferUploads = 0;
+        return;
+    }
+#ifdef HAS_GPU_TIMER
+    if (queryActive) {
+        glEndQuery(GL_TIME_ELAPSED);
+        queryPending[frameIndex % GPU_QUERIES] = true;
+        queryActive = false;
+    }
+#endif
+    double now = glfwGetTime();
+    int index = frameIndex % PROFILE_FRAMES;
+    frameTimes[index] = (lastFrame > 0.0) ? (now - lastFrame) * 1000.0f : 0.0f;
+    lastFrame = now;
+    gpuTimes[index] = lastGpuTime;
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        stageTimes[i][index] = currentStages[i];
+        currentStages[i] = 0.0f;
+    }
+    lastDrawCalls = drawCalls;
+    lastUniformUploads = uniformUploads;
+    lastBufferUploads = bufferUploads;
+    drawCalls = 0;
+    uniformUploads = 0;
+    bufferUploads = 0;
+    frameIndex++;
+}
+
+void FrameProfiler::beginStage(ProfileStage stage) {
+    if (!enabled) return;
+    stageStart[stage] = glfwGetTime();
+}
+
+void FrameProfiler::endStage(ProfileStage stage) {
+    if (!enabled) return;
+    // Stages can run more than once between frames
+    currentStages[stage] += (glfwGetTime() - stageStart[stage]) * 1000.0f;
+}
+
+const float* FrameProfiler::getFrameTimes() {
+    return frameTimes;
+}
+
+const float* FrameProfiler::getGpuTimes() {
+    return gpuTimes;
+}
+
+int FrameProfiler::getOffset() {
+    return frameIndex % PROFILE_FRAMES;
+}
+
+static float average(const float *values) {
+    float total = 0.0f;
+    for (int i = 0; i < PROFILE_FRAMES; i++) {
+        total += values[i];
+    }
+    return total / PROFILE_FRAMES;
+}
+
+float FrameProfiler::getAverageFrameTime() {
+    return average(frameTimes);
+}
+
+float FrameProfiler::getAverageGpuTime() {
+    return average(gpuTimes);
+}
+
+float FrameProfiler::getAverageStageTime(ProfileStage stage) {
+    return average(stageTimes[stage]);
+}
+
+float FrameProfiler::getMaxStageTime(ProfileStage stage) {
+    return *std::max_element(stageTimes[stage], stageTimes[stage] + PROFILE_FRAMES);
+}
+
+bool FrameProfiler::hasGpuTimer() {
+#ifdef HAS_GPU_TIMER
+    return true;
+#else
+    return false;
+#endif
+}
+
+unsigned int FrameProfiler::getDrawCalls() {
+    return lastDrawCalls;
+}
+
+unsigned int FrameProfiler::getUniformUploads() {
+    return lastUniformUploads;
+}
+
+unsigned int FrameProfiler::getBufferUploads() {
+    return lastBufferUploads;
+}
+
+void FrameProfiler::setFontAtlasTime(float time) {
+    fontAtlasTime = time;
+}
+
+float FrameProfiler::getFontAtlasTime() {
+    return fontAtlasTime;
+}
+
+void FrameProfiler::setFirstFrameTime(float time) {
+    firstFrameTime = time;
+}
+
+float FrameProfiler::getFirstFrameTime() {
+    return firstFrameTime;
+}
@@ -0,0 +1,88 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#define PROFILE_FRAMES 240
+#define GPU_QUERIES 4
+
+typedef enum : int {
+    POLL_EVENTS, UPDATE_MOUSE, UPDATE_PUZZLE, RENDER_PUZZLE,
+    CHECK_OUTLINE, RESOLVE_SCENE, RENDER_GUI, SWAP_BUFFERS, STAGE_COUNT
+} ProfileStage;
+
+// Per-stage CPU times, GPU frame time and GL call counts of recent frames
+class FrameProfiler {
+    public:
+        static FrameProfiler& get();
+        static const char *stageNames[STAGE_COUNT];
+        bool isEnabled();
+        // Needs a current GL context, queries are created and deleted here
+        void setEnabled(bool enabled);
+        void beginFrame();
+        void endFrame();
+        void beginStage(ProfileStage stage);
+        void endStage(ProfileStage stage);
+
+        // Counted even when disabled, a single increment is cheaper than a check
+        static void countDrawCall() { drawCalls++; }
+        static void countUniform() { uniformUploads++; }
+        static void countBufferUpload() { bufferUploads++; }
+
+        // Oldest first after getOffset(), in milliseconds
+        const float* getFrameTimes();
+        const float* getGpuTimes();
+        int getOffset();
+        float getAverageFrameTime();
+        float getAverageGpuTime();
+        float getAverageStageTime(ProfileStage stage);
+        float getMaxStageTime(ProfileStage stage);
+        bool hasGpuTimer();
+        // Of the last finished frame
+        unsigned int getDrawCalls();
+        unsigned int getUniformUploads();
+        unsigned int getBufferUploads();
+        // Startup costs in milliseconds, first frame counts from glfwInit, -1 until drawn
+        void setFontAtlasTime(float time);
+        float getFontAtlasTime();
+        void setFirstFrameTime(float time);
+        float getFirstFrameTime();
+
+    private:
+        FrameProfiler();
+        bool enabled;
+        int frameIndex;
+        double lastFrame;
+        double stageStart[STAGE_COUNT];
+        float currentStages[STAGE_COUNT];
+        float frameTimes[PROFILE_FRAMES];
+        float gpuTimes[PROFILE_FRAMES];
+        float stageTimes[STAGE_COUNT][PROFILE_FRAMES];
+
+        unsigned int queries[GPU_QUERIES];
+        bool queryPending[GPU_QUERIES];
+        bool queryActive;
+        float lastGpuTime;
+
+        unsigned int lastDrawCalls, lastUniformUploads, lastBufferUploads;
+        float fontAtlasTime, firstFrameTime;
+        static unsigned int drawCalls, uniformUploads, bufferUploads;
+};
+
+#endif // profiler.h
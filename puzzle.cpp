@@ -18,10 +18,46 @@
  **************************************************************************/
 
 #include "puzzle.h"
+#include "movetable.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <queue>
+
+// 80 piece slots with up to 4 stickers each, then the slice configurations
+#define PIECE_SLOTS 80
+#define CONFIG_KEYS 20
+
+// Lists of the slots a move changes: turns by cell and direction, then gyros, then rotations
+#define TURN_SLOTS 0
+#define GYRO_SLOTS 48
+#define ROTATE_SLOTS 56
+#define MOVED_LISTS 62
+
+typedef std::array<uint64_t, PIECE_SLOTS * 4 * 9 + CONFIG_KEYS> ZobristKeys;
+
+static ZobristKeys generateKeys() {
+    // splitmix64 with a fixed seed so hashes are stable between runs
+    ZobristKeys keys;
+    uint64_t state = 0x3A4C0DE5ULL;
+    for (size_t i = 0; i < keys.size(); i++) {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        keys[i] = z ^ (z >> 31);
+    }
+    return keys;
+}
+
+static const ZobristKeys& zobristKeys() {
+    static const ZobristKeys keys = generateKeys();
+    return keys;
+}
 
 std::array<Color, 8> Puzzle::scheme = {PURPLE, PINK, RED, ORANGE, WHITE, YELLOW, GREEN, BLUE};
 
 Puzzle::Puzzle() {
+    hashed = true;
     resetPuzzle();
 }
 
@@ -42,6 +78,7 @@ void Puzzle::resetPuzzle() {
     backCell[0] = {scheme[7], scheme[5], UNUSED, UNUSED};
     backCell[1] = {scheme[7], UNUSED, UNUSED, UNUSED};
     backCell[2] = {scheme[7], scheme[4], UNUSED, UNUSED};
+    rehash();
 }
 
 void Puzzle::initCell(CellData& cell, Color center, std::array<Color, 6> faces) {
@@ -102,7 +139,7 @@ void Puzzle::initSlice(SliceData& slice, Color center, std::array<Color, 4> face
     }
 }
 
-bool Puzzle::canRotateCell(CellLocation cell, RotateDirection direction) {
+bool Puzzle::canRotateCell(CellLocation cell, RotateDirection direction) const {
     switch (cell) {
         case IN:
         case OUT:
@@ -122,6 +159,7 @@ bool Puzzle::canRotateCell(CellLocation cell, RotateDirection direction) {
 
 void Puzzle::rotateCell(CellLocation cell, RotateDirection direction) {
     if (!canRotateCell(cell, direction)) return;
+    if (hashed) stickerHash ^= hashSlots(movedSlots(TURN_SLOTS + (int)cell * 6 + (int)direction));
     switch (cell) {
         case IN:
             rotateSlice(leftCell[2], direction, 2);
@@ -155,6 +193,7 @@ void Puzzle::rotateCell(CellLocation cell, RotateDirection direction) {
             rotatePSliceCell(cell);
             break;
     }
+    if (hashed) stickerHash ^= hashSlots(movedSlots(TURN_SLOTS + (int)cell * 6 + (int)direction));
 }
 
 void Puzzle::rotateCellX(CellData& cell, RotateDirection direction) {
@@ -331,6 +370,8 @@ void Puzzle::rotatePSliceCell(CellLocation cell) {
 }
 
 void Puzzle::gyroCell(CellLocation cell) {
+    if (cell == IN || cell == OUT) return;
+    if (hashed) stickerHash ^= hashSlots(movedSlots(GYRO_SLOTS + (int)cell));
     switch (cell) {
         case RIGHT:
         case LEFT:
@@ -344,10 +385,10 @@ void Puzzle::gyroCell(CellLocation cell) {
         case BACK:
             gyroCellZ(cell);
             break;
-        case IN:
-        case OUT:
-            return;
+        default:
+            break;
     }
+    if (hashed) stickerHash ^= hashSlots(movedSlots(GYRO_SLOTS + (int)cell));
 }
 
 void Puzzle::gyroCellX(CellLocation cell) {
@@ -467,7 +508,7 @@ void Puzzle::gyroCellZ(CellLocation cell) {
     }
 }
 
-bool Puzzle::canGyroMiddle(int direction) {
+bool Puzzle::canGyroMiddle(int direction) const {
     if (outerSlicePos == 1) {
         return middleSlicePos + direction <= 2 && middleSlicePos + direction >= -1;
     } else {
@@ -492,11 +533,173 @@ void Puzzle::gyroMiddleSlice(int direction) {
     }
 }
 
-bool Puzzle::canRotatePuzzle(RotateDirection direction) {
+#ifndef NDEBUG
+// Every sticker of a cell has the same colour, whichever colour that is
+static bool isRecoloured(const Puzzle& puzzle) {
+    PackedPuzzle solved{Puzzle()}, state(puzzle);
+    std::array<int, 9> colors;
+    colors.fill(-1);
+    for (int i = 0; i < STICKER_COUNT; i++) {
+        int& color = colors[solved.getSticker(i)];
+        if (color == -1) color = state.getSticker(i);
+        if (color != state.getSticker(i)) return false;
+    }
+    return true;
+}
+#endif
+
+std::vector<Puzzle> Puzzle::findSolvedOrientations() {
+    // Rotations and gyros from every slice configuration, each only where it is
+    // legal, with the slice gyros that set them up. Turns are left out
+    const MoveTable& table = MoveTable::get();
+    std::vector<Puzzle> orientations;
+    std::set<uint64_t> visited, stickers;
+    std::queue<Puzzle> pending;
+    for (int config = 0; config < CONFIG_COUNT; config++) {
+        Puzzle puzzle;
+        PackedPuzzle::decodeConfig(config, puzzle.outerSlicePos, puzzle.middleSlicePos, puzzle.middleSliceDir);
+        visited.insert(puzzle.getHash());
+        pending.push(puzzle);
+    }
+    while (!pending.empty()) {
+        Puzzle puzzle = pending.front();
+        pending.pop();
+        if (stickers.insert(puzzle.stickerHash).second) {
+            orientations.push_back(puzzle);
+        }
+        for (int move = 0; move < MOVE_COUNT; move++) {
+            const MoveEntry& entry = table.moveEntry(move);
+            if (entry.type == TURN || !MoveTable::canApply(puzzle, entry)) continue;
+            Puzzle next = puzzle;
+            MoveTable::applyToPuzzle(next, entry);
+            if (visited.insert(next.getHash()).second) {
+                pending.push(next);
+            }
+        }
+    }
+    // The rotations of a tesseract, each one only recolours the solved puzzle
+    assert(orientations.size() == 192);
+    assert(std::all_of(orientations.begin(), orientations.end(), isRecoloured));
+    return orientations;
+}
+
+const std::vector<Puzzle>& Puzzle::solvedOrientations() {
+    static const std::vector<Puzzle> orientations = findSolvedOrientations();
+    return orientations;
+}
+
+bool Puzzle::isSolved() const {
+    static const std::set<uint64_t> solved = []() {
+        std::set<uint64_t> hashes;
+        for (const Puzzle& puzzle : solvedOrientations()) {
+            hashes.insert(puzzle.stickerHash);
+        }
+        return hashes;
+    }();
+    return solved.count(stickerHash) != 0;
+}
+
+uint64_t Puzzle::getHash() const {
+    int config = ((outerSlicePos == 1) ? 0 : 10) + (middleSlicePos + 2) * 2 + ((middleSliceDir == UP) ? 1 : 0);
+    return stickerHash ^ zobristKeys()[PIECE_SLOTS * 4 * 9 + config];
+}
+
+bool Puzzle::operator==(const Puzzle& other) const {
+    if (getHash() != other.getHash()) return false;
+    return std::memcmp(&leftCell, &other.leftCell, sizeof(CellData)) == 0 &&
+           std::memcmp(&rightCell, &other.rightCell, sizeof(CellData)) == 0 &&
+           std::memcmp(&innerSlice, &other.innerSlice, sizeof(SliceData)) == 0 &&
+           std::memcmp(&outerSlice, &other.outerSlice, sizeof(SliceData)) == 0 &&
+           std::memcmp(&topCell, &other.topCell, sizeof(Piece)) == 0 &&
+           std::memcmp(&bottomCell, &other.bottomCell, sizeof(Piece)) == 0 &&
+           std::memcmp(&frontCell, &other.frontCell, sizeof(frontCell)) == 0 &&
+           std::memcmp(&backCell, &other.backCell, sizeof(backCell)) == 0 &&
+           middleSlicePos == other.middleSlicePos && outerSlicePos == other.outerSlicePos &&
+           middleSliceDir == other.middleSliceDir;
+}
+
+bool Puzzle::operator!=(const Puzzle& other) const {
+    return !(*this == other);
+}
+
+void Puzzle::rehash() {
+    if (!hashed) return;
+    stickerHash = 0;
+    for (int slot = 0; slot < PIECE_SLOTS; slot++) {
+        stickerHash ^= hashPiece(slot, slotPiece(slot));
+    }
+}
+
+const Piece& Puzzle::slotPiece(int slot) const {
+    // Slots number the cells [x][y][z] and the slices [y][z], then the middle pieces
+    if (slot < 27) return leftCell[slot / 9][slot / 3 % 3][slot % 3];
+    if (slot < 54) return rightCell[(slot - 27) / 9][(slot - 27) / 3 % 3][(slot - 27) % 3];
+    if (slot < 63) return innerSlice[(slot - 54) / 3][(slot - 54) % 3];
+    if (slot < 72) return outerSlice[(slot - 63) / 3][(slot - 63) % 3];
+    if (slot == 72) return topCell;
+    if (slot == 73) return bottomCell;
+    if (slot < 77) return frontCell[slot - 74];
+    return backCell[slot - 77];
+}
+
+uint64_t Puzzle::hashPiece(int slot, const Piece& piece) const {
+    assert(piece.a <= UNUSED && piece.b <= UNUSED && piece.c <= UNUSED && piece.d <= UNUSED);
+    const uint64_t *keys = &zobristKeys()[slot * 4 * 9];
+    return keys[piece.a] ^ keys[9 + piece.b] ^ keys[18 + piece.c] ^ keys[27 + piece.d];
+}
+
+uint64_t Puzzle::hashSlots(const std::vector<MovedSlot>& slots) const {
+    // Same as hashPiece over each slot, with the keys looked up once
+    const ZobristKeys& keys = zobristKeys();
+    uint64_t hash = 0;
+    for (const MovedSlot& moved : slots) {
+        const Piece& piece = *reinterpret_cast<const Piece*>(reinterpret_cast<const char*>(this) + moved.offset);
+        const uint64_t *slotKeys = &keys[moved.slot * 4 * 9];
+        hash ^= slotKeys[piece.a] ^ slotKeys[9 + piece.b] ^ slotKeys[18 + piece.c] ^ slotKeys[27 + piece.d];
+    }
+    return hash;
+}
+
+const std::vector<Puzzle::MovedSlot>& Puzzle::movedSlots(int list) {
+    static const std::vector<std::vector<MovedSlot>> moved = findMovedSlots();
+    return moved[list];
+}
+
+std::vector<std::vector<Puzzle::MovedSlot>> Puzzle::findMovedSlots() {
+    // Label every sticker with its own index, the slots whose labels change are the ones a move hashes
+    std::vector<std::vector<MovedSlot>> moved(MOVED_LISTS);
+    for (int list = 0; list < MOVED_LISTS; list++) {
+        Puzzle before;
+        before.hashed = false;
+        std::array<Color*, STICKER_COUNT> stickers = PackedPuzzle::stickerPointers(before);
+        for (int i = 0; i < STICKER_COUNT; i++) {
+            *stickers[i] = (Color)i;
+        }
+        Puzzle after = before;
+        if (list < GYRO_SLOTS) {
+            after.rotateCell((CellLocation)((list - TURN_SLOTS) / 6), (RotateDirection)((list - TURN_SLOTS) % 6));
+        } else if (list < ROTATE_SLOTS) {
+            after.gyroCell((CellLocation)(list - GYRO_SLOTS));
+        } else if (after.canRotatePuzzle((RotateDirection)(list - ROTATE_SLOTS))) {
+            after.rotatePuzzle((RotateDirection)(list - ROTATE_SLOTS));
+        }
+        for (int slot = 0; slot < PIECE_SLOTS; slot++) {
+            const Piece& piece = after.slotPiece(slot);
+            if (std::memcmp(&before.slotPiece(slot), &piece, sizeof(Piece)) != 0) {
+                uint16_t offset = reinterpret_cast<const char*>(&piece) - reinterpret_cast<const char*>(&after);
+                moved[list].push_back({(uint8_t)slot, offset});
+            }
+        }
+    }
+    return moved;
+}
+
+bool Puzzle::canRotatePuzzle(RotateDirection direction) const {
     return direction == YZ || direction == ZY;
 }
 
 void Puzzle::rotatePuzzle(RotateDirection direction) {
+    if (hashed) stickerHash ^= hashSlots(movedSlots(ROTATE_SLOTS + (int)direction));
     rotateCellX(leftCell, direction);
     rotateCellX(rightCell, direction);
     rotateSlice(innerSlice, direction, 1);
@@ -521,4 +724,5 @@ void Puzzle::rotatePuzzle(RotateDirection direction) {
     }
 
     gyroMiddleSlice(0);
+    if (hashed) stickerHash ^= hashSlots(movedSlots(ROTATE_SLOTS + (int)direction));
 }
@@ -25,6 +25,7 @@
 #include <array>
 #include <map>
 #include <set>
+#include <cstdint>
 
 typedef enum : int {
     PURPLE, PINK, RED, ORANGE, WHITE, YELLOW, GREEN, BLUE, UNUSED
@@ -52,18 +53,29 @@ typedef std::array<SliceData, 3> CellData;
 class Puzzle {
     friend class PuzzleRenderer;
     friend class PuzzleController;
+    friend class PuzzleSimulation;
+    friend class PackedPuzzle;
+    friend class MoveTable;
     public:
         static std::array<Color, 8> scheme;
         Puzzle();
         void resetPuzzle();
-        bool canRotateCell(CellLocation cell, RotateDirection direction);
+        bool canRotateCell(CellLocation cell, RotateDirection direction) const;
         void rotateCell(CellLocation cell, RotateDirection direction);
         void gyroCell(CellLocation cell);
         void gyroOuterSlice();
-        bool canGyroMiddle(int direction);
+        bool canGyroMiddle(int direction) const;
         void gyroMiddleSlice(int direction);
-        bool canRotatePuzzle(RotateDirection direction);
+        bool canRotatePuzzle(RotateDirection direction) const;
         void rotatePuzzle(RotateDirection direction);
+        // Zobrist hash of the stickers and slice configuration
+        uint64_t getHash() const;
+        // Solved in any orientation reachable by rotatePuzzle and gyros
+        bool isSolved() const;
+        // Each distinct solved orientation once, in the slice configuration it was reached in
+        static const std::vector<Puzzle>& solvedOrientations();
+        bool operator==(const Puzzle& other) const;
+        bool operator!=(const Puzzle& other) const;
 
     private:
         // [x][y][z]
@@ -84,6 +96,10 @@ class Puzzle {
         Piece bottomCell;
         std::array<Piece, 3> frontCell;
         std::array<Piece, 3> backCell;
+        // Maintained by every public move, configuration is mixed in by getHash
+        uint64_t stickerHash;
+        // Off for puzzles whose stickers are labelled with indices instead of colours
+        bool hashed;
 
         void initCell(CellData& cell, Color center, const std::array<Color, 6> faces);
         void initSlice(SliceData& slice, Color center, const std::array<Color, 4> faces);
@@ -96,6 +112,20 @@ class Puzzle {
         void gyroCellX(CellLocation cell);
         void gyroCellY(CellLocation cell);
         void gyroCellZ(CellLocation cell);
+
+        // A slot a move changes, with the offset of its piece so hashing skips finding it
+        struct MovedSlot {
+            uint8_t slot;
+            uint16_t offset;
+        };
+
+        void rehash();
+        const Piece& slotPiece(int slot) const;
+        uint64_t hashPiece(int slot, const Piece& piece) const;
+        uint64_t hashSlots(const std::vector<MovedSlot>& slots) const;
+        static const std::vector<MovedSlot>& movedSlots(int list);
+        static std::vector<std::vector<MovedSlot>> findMovedSlots();
+        static std::vector<Puzzle> findSolvedOrientations();
 };
 
 #endif // puzzle.h
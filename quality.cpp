@@ -0,0 +1,288 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+#include <glad/gl.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "quality.h"
+#include "scheduler.h"
+#ifndef __EMSCRIPTEN__
+// Defined in the simulation library, parse errors throw there too
+#define RYML_DEFAULT_CALLBACK_USES_EXCEPTIONS
+#include <rapidyaml-0.6.0.hpp>
+#endif
+
+const char *RenderQuality::tierNames[QUALITY_TIER_COUNT] = {
+    "Low", "Medium", "High", "Ultra"
+};
+
+const QualitySettings RenderQuality::tiers[QUALITY_TIER_COUNT] = {
+    {0, 0.5f, EDGES_SHADER},
+    {2, 0.75f, EDGES_SHADER},
+    {4, 1.0f, EDGES_LINES},
+    {8, 1.0f, EDGES_LINES}
+};
+
+const char *RenderQuality::edgeModeNames[EDGE_MODE_COUNT] = {
+    "Lines", "Shader outline"
+};
+
+bool QualitySettings::operator==(const QualitySettings& other) const {
+    return samples == other.samples && renderScale == other.renderScale && edges == other.edges;
+}
+
+// Rough fill cost, for stepping down from settings that match no tier
+static float settingsCost(const QualitySettings& settings) {
+    return std::max(settings.samples, 1) * settings.renderScale * settings.renderScale;
+}
+
+RenderQuality& RenderQuality::get() {
+    static RenderQuality quality;
+    return quality;
+}
+
+RenderQuality::RenderQuality() {
+    window = NULL;
+    settings = tiers[QUALITY_ULTRA];
+    automatic = false;
+    maxSamples = 0;
+    sceneFbo = resolveFbo = 0;
+    colorBuffer = depthBuffer = resolveBuffer = 0;
+    targetsValid = false;
+    windowWidth = windowHeight = 0;
+    sceneWidth = sceneHeight = 0;
+    lastContinuous = false;
+    slowFrames = 0;
+    slowTime = 0.0;
+}
+
+void RenderQuality::attach(GLFWwindow *window) {
+    this->window = window;
+    glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+    load();
+    settings.samples = std::min(settings.samples, maxSamples);
+}
+
+const QualitySettings& RenderQuality::getSettings() {
+    return settings;
+}
+
+void RenderQuality::setSettings(const QualitySettings& settings) {
+    this->settings = settings;
+    this->settings.samples = std::min(std::max(settings.samples, 0), maxSamples);
+    this->settings.renderScale = std::min(std::max(settings.renderScale, 0.25f), 1.0f);
+    targetsValid = false;
+    slowFrames = 0;
+    slowTime = 0.0;
+    save();
+    FrameScheduler::get().requestRedraw();
+}
+
+QualityTier RenderQuality::getTier() {
+    for (int i = 0; i < QUALITY_TIER_COUNT; i++) {
+        QualitySettings tier = tiers[i];
+        tier.samples = std::min(tier.samples, maxSamples);
+        if (tier == settings) return (QualityTier)i;
+    }
+    return QUALITY_CUSTOM;
+}
+
+void RenderQuality::setTier(QualityTier tier) {
+    if (tier >= 0 && tier < QUALITY_TIER_COUNT) setSettings(tiers[tier]);
+}
+
+bool RenderQuality::isAutomatic() {
+    return automatic;
+}
+
+void RenderQuality::setAutomatic(bool automatic) {
+    this->automatic = automatic;
+    slowFrames = 0;
+    slowTime = 0.0;
+    save();
+}
+
+int RenderQuality::getMaxSamples() {
+    return maxSamples;
+}
+
+bool RenderQuality::needsOffscreen() {
+    return settings.samples > 0 || settings.renderScale < 1.0f;
+}
+
+void RenderQuality::updateTargets() {
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    if (targetsValid && width == windowWidth && height == windowHeight) return;
+    deleteTargets();
+    windowWidth = width;
+    windowHeight = height;
+    targetsValid = true;
+    if (!needsOffscreen()) return;
+
+    sceneWidth = std::max((int)std::lround(width * settings.renderScale), 1);
+    sceneHeight = std::max((int)std::lround(height * settings.renderScale), 1);
+    glGenFramebuffers(1, &sceneFbo);
+    glGenRenderbuffers(1, &colorBuffer);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFbo);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, settings.samples, GL_RGBA8, sceneWidth, sceneHeight);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, settings.samples, GL_DEPTH_COMPONENT24, sceneWidth, sceneHeight);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+    // Multisampled blits can't scale and need the same format on both sides,
+    // which the window's may not be, so they always resolve at scene size first
+    bool resolve = settings.samples > 0;
+    if (complete && resolve) {
+        glGenFramebuffers(1, &resolveFbo);
+        glGenRenderbuffers(1, &resolveBuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, resolveFbo);
+        glBindRenderbuffer(GL_RENDERBUFFER, resolveBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, sceneWidth, sceneHeight);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, resolveBuffer);
+        complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // Incomplete targets fall back to drawing straight into the window
+    if (!complete) {
+        deleteTargets();
+        targetsValid = true;
+    }
+}
+
+void RenderQuality::deleteTargets() {
+    if (sceneFbo) glDeleteFramebuffers(1, &sceneFbo);
+    if (resolveFbo) glDeleteFramebuffers(1, &resolveFbo);
+    if (colorBuffer) glDeleteRenderbuffers(1, &colorBuffer);
+    if (depthBuffer) glDeleteRenderbuffers(1, &depthBuffer);
+    if (resolveBuffer) glDeleteRenderbuffers(1, &resolveBuffer);
+    sceneFbo = resolveFbo = 0;
+    colorBuffer = depthBuffer = resolveBuffer = 0;
+    targetsValid = false;
+}
+
+void RenderQuality::beginScene() {
+    updateTargets();
+    if (sceneFbo) {
+        glBindFramebuffer(GL_FRAMEBUFFER, sceneFbo);
+        glViewport(0, 0, sceneWidth, sceneHeight);
+    } else {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, windowWidth, windowHeight);
+    }
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void RenderQuality::endScene() {
+    if (!sceneFbo) return;
+    unsigned int source = sceneFbo;
+    if (resolveFbo) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFbo);
+        glBlitFramebuffer(0, 0, sceneWidth, sceneHeight, 0, 0, sceneWidth, sceneHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        source = resolveFbo;
+    }
+    bool scaled = sceneWidth != windowWidth || sceneHeight != windowHeight;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, source);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, sceneWidth, sceneHeight, 0, 0, windowWidth, windowHeight,
+        GL_COLOR_BUFFER_BIT, scaled ? GL_LINEAR : GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, windowWidth, windowHeight);
+}
+
+void RenderQuality::frameDrawn(double frameTime, bool continuous) {
+    bool counted = automatic && continuous && lastContinuous;
+    lastContinuous = continuous;
+    if (!counted) {
+        slowFrames = 0;
+        slowTime = 0.0;
+        return;
+    }
+    slowFrames++;
+    slowTime += frameTime;
+    if (slowFrames < AUTO_QUALITY_FRAMES) return;
+    double average = slowTime / slowFrames;
+    slowFrames = 0;
+    slowTime = 0.0;
+    if (average <= AUTO_QUALITY_SLACK / FrameScheduler::get().getRefreshRate()) return;
+
+    // Only ever steps down, frames that keep up with the display can't show headroom
+    float cost = settingsCost(settings);
+    for (int i = QUALITY_TIER_COUNT - 1; i >= 0; i--) {
+        if (settingsCost(tiers[i]) < cost) {
+            setTier((QualityTier)i);
+            return;
+        }
+    }
+}
+
+void RenderQuality::load() {
+#ifndef __EMSCRIPTEN__
+    std::ifstream file(QUALITY_FILE, std::ios::binary);
+    if (file.fail()) return;
+    std::vector<char> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    QualitySettings loaded = settings;
+    bool loadedAutomatic = automatic;
+    try {
+        ryml::Tree tree = ryml::parse_in_place(ryml::to_csubstr(QUALITY_FILE), ryml::substr(buffer.data(), buffer.size()));
+        ryml::ConstNodeRef root = tree.crootref();
+        if (!root.is_map()) throw std::runtime_error("expected a map of settings");
+        if (root.has_child("samples")) root["samples"] >> loaded.samples;
+        if (root.has_child("render_scale")) root["render_scale"] >> loaded.renderScale;
+        if (root.has_child("edges")) {
+            loaded.edges = (root["edges"].val() == "shader") ? EDGES_SHADER : EDGES_LINES;
+        }
+        if (root.has_child("automatic")) root["automatic"] >> loadedAutomatic;
+    } catch (std::runtime_error& e) {
+        // Keeps the defaults, the file is written again on the next change
+        std::cerr << QUALITY_FILE << ": " << e.what() << std::endl;
+        return;
+    }
+    settings = loaded;
+    settings.samples = std::max(settings.samples, 0);
+    settings.renderScale = std::min(std::max(settings.renderScale, 0.25f), 1.0f);
+    automatic = loadedAutomatic;
+#endif
+}
+
+void RenderQuality::save() {
+#ifndef __EMSCRIPTEN__
+    ryml::Tree tree;
+    ryml::NodeRef root = tree.rootref();
+    root |= ryml::MAP;
+    root["samples"] << settings.samples;
+    root["render_scale"] << settings.renderScale;
+    root["edges"] << (settings.edges == EDGES_SHADER ? "shader" : "lines");
+    root["automatic"] << ryml::fmt::boolalpha(automatic);
+    std::ofstream file(QUALITY_FILE);
+    file << ryml::emitrs_yaml<std::string>(tree);
+#endif
+}
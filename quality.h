@@ -0,0 +1,109 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+
+#ifndef QUALITY_H
+#define QUALITY_H
+
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+// Written to the working directory, where scramble.txt is read from
+#define QUALITY_FILE "quality.yaml"
+// Back to back frames averaged before the automatic tier decides anything
+#define AUTO_QUALITY_FRAMES 90
+// Drops a tier when those frames average this much over the display interval
+#define AUTO_QUALITY_SLACK 1.25
+
+typedef enum : int {
+    QUALITY_LOW, QUALITY_MEDIUM, QUALITY_HIGH, QUALITY_ULTRA,
+    QUALITY_TIER_COUNT,
+    // Settings that match none of the tiers
+    QUALITY_CUSTOM = QUALITY_TIER_COUNT
+} QualityTier;
+
+typedef enum : int {
+    // GL lines over the faces, as wide as the driver allows
+    EDGES_LINES,
+    // Darkened face borders, no extra draws
+    EDGES_SHADER,
+    EDGE_MODE_COUNT
+} EdgeMode;
+
+struct QualitySettings {
+    // 0 for no multisampling
+    int samples;
+    // Fraction of the framebuffer size the puzzle is drawn at
+    float renderScale;
+    EdgeMode edges;
+    bool operator==(const QualitySettings& other) const;
+};
+
+// Multisampling and render scale for the puzzle, which is drawn offscreen
+// and resolved into the window when either needs it. The GUI is drawn at
+// full size on top. Optionally steps down a tier when frames run long
+class RenderQuality {
+    public:
+        static RenderQuality& get();
+        static const char *tierNames[QUALITY_TIER_COUNT];
+        static const QualitySettings tiers[QUALITY_TIER_COUNT];
+        static const char *edgeModeNames[EDGE_MODE_COUNT];
+        // Needs the window's context to be current, loads the saved settings
+        void attach(GLFWwindow *window);
+
+        const QualitySettings& getSettings();
+        // Samples are clamped to what the driver supports, changes are saved
+        void setSettings(const QualitySettings& settings);
+        QualityTier getTier();
+        void setTier(QualityTier tier);
+        bool isAutomatic();
+        void setAutomatic(bool automatic);
+        int getMaxSamples();
+
+        // Binds the offscreen target if the settings need one, with its viewport
+        void beginScene();
+        // Resolves and scales the puzzle into the window, which is bound afterwards
+        void endScene();
+        // Frame times while drawing continuously, the first after a pause is ignored
+        void frameDrawn(double frameTime, bool continuous);
+
+    private:
+        RenderQuality();
+        GLFWwindow *window;
+        QualitySettings settings;
+        bool automatic;
+        int maxSamples;
+
+        unsigned int sceneFbo, resolveFbo;
+        unsigned int colorBuffer, depthBuffer, resolveBuffer;
+        bool targetsValid;
+        int windowWidth, windowHeight;
+        int sceneWidth, sceneHeight;
+
+        bool lastContinuous;
+        int slowFrames;
+        double slowTime;
+
+        bool needsOffscreen();
+        void updateTargets();
+        void deleteTargets();
+        void load();
+        void save();
+};
+
+#endif // quality.h
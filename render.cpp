@@ -21,10 +21,14 @@
 #include "render.h"
 #include "control.h"
 #include "constants.h"
+#include "profiler.h"
 #include <iostream>
 #include <array>
 #include <string>
 #include <algorithm>
+#include <cstddef>
+#include <cmath>
+#include <cstring>
 
 void mat4x4_scale_pos(mat4x4 M, float k) {
     for (int i = 0; i < 3; i++) {
@@ -36,48 +40,161 @@ float smoothstep(float t) {
     return t * t * (3 - 2 * t);
 }
 
+// Whether the segment from a to b lies along one of the mesh's drawn edges
+static bool onMeshEdge(const PieceType& type, const float *a, const float *b) {
+    for (size_t i = 0; i < type.edges.size(); i += 2) {
+        const float *start = &type.vertices[type.edges[i] * 4];
+        const float *end = &type.vertices[type.edges[i + 1] * 4];
+        vec3 edge, toA, toB, crossA, crossB;
+        vec3_sub(edge, end, start);
+        vec3_sub(toA, a, start);
+        vec3_sub(toB, b, start);
+        vec3_mul_cross(crossA, edge, toA);
+        vec3_mul_cross(crossB, edge, toB);
+        if (vec3_len(crossA) > 1e-4f || vec3_len(crossB) > 1e-4f) continue;
+        float length = vec3_mul_inner(edge, edge);
+        float tA = vec3_mul_inner(toA, edge) / length;
+        float tB = vec3_mul_inner(toB, edge) / length;
+        if (tA > -1e-4f && tA < 1 + 1e-4f && tB > -1e-4f && tB < 1 + 1e-4f) return true;
+    }
+    return false;
+}
+
+void setupInstanceAttributes(unsigned int instanceVbo) {
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+    // mat4 attributes take up one location per column
+    for (int i = 0; i < 4; i++) {
+        glVertexAttribPointer(2 + i, 4, GL_FLOAT, GL_FALSE, sizeof(PieceInstance), (void*)(i * 4 * sizeof(float)));
+        glEnableVertexAttribArray(2 + i);
+        glVertexAttribDivisor(2 + i, 1);
+    }
+    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(PieceInstance), (void*)offsetof(PieceInstance, colors));
+    glEnableVertexAttribArray(6);
+    glVertexAttribDivisor(6, 1);
+    glVertexAttribPointer(8, 4, GL_FLOAT, GL_FALSE, sizeof(PieceInstance), (void*)offsetof(PieceInstance, anim));
+    glEnableVertexAttribArray(8);
+    glVertexAttribDivisor(8, 1);
+}
+
 PieceMesh::PieceMesh(PieceType type) {
     length1 = type.triangles.size();
     length2 = type.edges.size();
-    normals = type.normals;
-    glGenBuffers(1, &vbo);
-    glGenVertexArrays(1, &faceVao);
-    glGenVertexArrays(1, &edgeVao);
-    glGenBuffers(1, &faceEbo);
+    glGenBuffers(1, &faceVbo);
+    glGenBuffers(1, &edgeVbo);
     glGenBuffers(1, &edgeEbo);
+    glGenVertexArrays(2, faceVao);
+    glGenVertexArrays(2, edgeVao);
+    glGenBuffers(2, instanceVbo);
 
-    glBindVertexArray(faceVao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, type.vertices.size() * sizeof(float), type.vertices.data(), GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, faceEbo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, type.triangles.size() * sizeof(unsigned int), type.triangles.data(), GL_STATIC_DRAW);
-    // 3 floats for XYZ, 1 float for color
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    glBindVertexArray(edgeVao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    // Keep one instance allocated so per-piece draws never read past the buffer
+    PieceInstance empty = {};
+    for (int i = 0; i < 2; i++) {
+        instanceCount[i] = 0;
+        instanceCapacity[i] = 1;
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVbo[i]);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(PieceInstance), &empty, (i == SCENE_INSTANCES) ? GL_DYNAMIC_DRAW : GL_STREAM_DRAW);
+    }
+
+    // Faces are unindexed so every triangle carries its own normal. The edge
+    // coordinate is barycentric, except that sides not on a mesh edge stay at
+    // 1 so the shader outline only darkens real edges
+    std::vector<float> faceVertices;
+    faceVertices.reserve(length1 * 10);
+    for (unsigned int i = 0; i < length1; i += 3) {
+        const float *corners[3];
+        for (int j = 0; j < 3; j++) corners[j] = &type.vertices[type.triangles[i + j] * 4];
+        bool outlined[3];
+        for (int j = 0; j < 3; j++) outlined[j] = onMeshEdge(type, corners[(j + 1) % 3], corners[(j + 2) % 3]);
+        const float *normal = &type.normals[(i / 3) * 3];
+        for (int j = 0; j < 3; j++) {
+            faceVertices.insert(faceVertices.end(), corners[j], corners[j] + 4);
+            faceVertices.insert(faceVertices.end(), normal, normal + 3);
+            for (int k = 0; k < 3; k++) faceVertices.push_back((k == j || !outlined[k]) ? 1.0f : 0.0f);
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, faceVbo);
+    glBufferData(GL_ARRAY_BUFFER, faceVertices.size() * sizeof(float), faceVertices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, edgeVbo);
     glBufferData(GL_ARRAY_BUFFER, type.vertices.size() * sizeof(float), type.vertices.data(), GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, edgeEbo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, type.edges.size() * sizeof(unsigned int), type.edges.data(), GL_STATIC_DRAW);
-    // 3 floats for XYZ, 1 float for color
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+
+    // One pair of VAOs per instance buffer
+    for (int i = 0; i < 2; i++) {
+        glBindVertexArray(faceVao[i]);
+        glBindBuffer(GL_ARRAY_BUFFER, faceVbo);
+        // 3 floats for XYZ, 1 float for color, 3 floats for normal, 3 floats for edge coordinate
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 10 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 10 * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(7, 3, GL_FLOAT, GL_FALSE, 10 * sizeof(float), (void*)(4 * sizeof(float)));
+        glEnableVertexAttribArray(7);
+        glVertexAttribPointer(9, 3, GL_FLOAT, GL_FALSE, 10 * sizeof(float), (void*)(7 * sizeof(float)));
+        glEnableVertexAttribArray(9);
+        setupInstanceAttributes(instanceVbo[i]);
+
+        glBindVertexArray(edgeVao[i]);
+        glBindBuffer(GL_ARRAY_BUFFER, edgeVbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, edgeEbo);
+        if (i == 0) {
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, type.edges.size() * sizeof(unsigned int), type.edges.data(), GL_STATIC_DRAW);
+        }
+        // 3 floats for XYZ, 1 float for color
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        setupInstanceAttributes(instanceVbo[i]);
+    }
 }
 
-void PieceMesh::renderFaces(Shader* shader) {
-    shader->setVec3v("normals", normals);
-    glBindVertexArray(faceVao);
-    glDrawElements(GL_TRIANGLES, length1, GL_UNSIGNED_INT, 0);
+void PieceMesh::renderFaces() {
+    glBindVertexArray(faceVao[STREAM_INSTANCES]);
+    glDrawArrays(GL_TRIANGLES, 0, length1);
+    FrameProfiler::countDrawCall();
 }
 
 void PieceMesh::renderEdges() {
-    glBindVertexArray(edgeVao);
+    glBindVertexArray(edgeVao[STREAM_INSTANCES]);
     glDrawElements(GL_LINES, length2, GL_UNSIGNED_INT, 0);
+    FrameProfiler::countDrawCall();
+}
+
+void PieceMesh::setInstances(const std::vector<PieceInstance>& instances, InstanceBuffer buffer) {
+    instanceCount[buffer] = instances.size();
+    if (instanceCount[buffer] == 0) return;
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVbo[buffer]);
+    if (instanceCount[buffer] > instanceCapacity[buffer]) {
+        instanceCapacity[buffer] = instanceCount[buffer];
+        GLenum usage = (buffer == SCENE_INSTANCES) ? GL_DYNAMIC_DRAW : GL_STREAM_DRAW;
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(PieceInstance), instances.data(), usage);
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(PieceInstance), instances.data());
+    }
+    FrameProfiler::countBufferUpload();
+}
+
+void PieceMesh::updateInstances(const PieceInstance *instances, unsigned int offset, unsigned int count, InstanceBuffer buffer) {
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVbo[buffer]);
+    glBufferSubData(GL_ARRAY_BUFFER, offset * sizeof(PieceInstance), count * sizeof(PieceInstance), instances);
+    FrameProfiler::countBufferUpload();
+}
+
+void PieceMesh::renderFacesInstanced(InstanceBuffer buffer) {
+    if (instanceCount[buffer] == 0) return;
+    glBindVertexArray(faceVao[buffer]);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, length1, instanceCount[buffer]);
+    FrameProfiler::countDrawCall();
+}
+
+unsigned int PieceMesh::getInstanceCount(InstanceBuffer buffer) {
+    return instanceCount[buffer];
+}
+
+void PieceMesh::renderEdgesInstanced(InstanceBuffer buffer) {
+    if (instanceCount[buffer] == 0) return;
+    glBindVertexArray(edgeVao[buffer]);
+    glDrawElementsInstanced(GL_LINES, length2, GL_UNSIGNED_INT, 0, instanceCount[buffer]);
+    FrameProfiler::countDrawCall();
 }
 
 Shader::Shader(const char *vertex, const char *fragment) {
@@ -116,35 +233,107 @@ Shader::Shader(const char *vertex, const char *fragment) {
     }
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
+    loadUniforms();
 }
 
 void Shader::use() {
     glUseProgram(program);
 }
 
-void Shader::setInt(std::string loc, int value) {
-    int shaderLocation = glGetUniformLocation(program, loc.c_str());
-    glUniform1i(shaderLocation, value);
+void Shader::loadUniforms() {
+    int count;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    for (int i = 0; i < count; i++) {
+        char name[256];
+        int length, size;
+        unsigned int type;
+        glGetActiveUniform(program, i, sizeof(name), &length, &size, &type, name);
+        int location = glGetUniformLocation(program, name);
+        if (location == -1) continue;
+        locations[name] = location;
+
+        // Arrays are reported as "name[0]", register the bare name and every element
+        std::string base(name, length);
+        if (base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0) {
+            base.resize(base.size() - 3);
+            locations[base] = location;
+            for (int j = 1; j < size; j++) {
+                std::string element = base + "[" + std::to_string(j) + "]";
+                locations[element] = glGetUniformLocation(program, element.c_str());
+            }
+        }
+    }
 }
 
-void Shader::setFloat(std::string loc, float value) {
-    int shaderLocation = glGetUniformLocation(program, loc.c_str());
-    glUniform1f(shaderLocation, value);
+int Shader::uniform(const char *name) {
+    std::map<std::string, int>::iterator it = locations.find(name);
+    if (it != locations.end()) {
+        return it->second;
+    }
+    // Unknown or optimised out, remember the miss as well
+    int location = glGetUniformLocation(program, name);
+    locations[name] = location;
+    return location;
+}
+
+void Shader::setInt(int loc, int value) {
+    glUniform1i(loc, value);
+    FrameProfiler::countUniform();
+}
+
+void Shader::setFloat(int loc, float value) {
+    glUniform1f(loc, value);
+    FrameProfiler::countUniform();
 }
 
-void Shader::setVec3(std::string loc, vec3 vector) {
-    int shaderLocation = glGetUniformLocation(program, loc.c_str());
-    glUniform3fv(shaderLocation, 1, vector);
+void Shader::setVec3(int loc, const vec3 vector) {
+    glUniform3fv(loc, 1, vector);
+    FrameProfiler::countUniform();
 }
 
-void Shader::setMat4(std::string loc, mat4x4 matrix) {
-    int shaderLocation = glGetUniformLocation(program, loc.c_str());
-    glUniformMatrix4fv(shaderLocation, 1, GL_FALSE, matrix[0]);
+void Shader::setMat4(int loc, mat4x4 matrix) {
+    glUniformMatrix4fv(loc, 1, GL_FALSE, matrix[0]);
+    FrameProfiler::countUniform();
 }
 
-void Shader::setVec3v(std::string loc, std::vector<float> vectors) {
-    int shaderLocation = glGetUniformLocation(program, loc.c_str());
-    glUniform3fv(shaderLocation, vectors.size() / 3, vectors.data());
+void Shader::setVec3v(int loc, const float *vectors, int count) {
+    glUniform3fv(loc, count, vectors);
+    FrameProfiler::countUniform();
+}
+
+void Shader::setVec3v(int loc, const std::vector<float>& vectors) {
+    glUniform3fv(loc, vectors.size() / 3, vectors.data());
+    FrameProfiler::countUniform();
+}
+
+void Shader::setFloatv(int loc, const float *values, int count) {
+    glUniform1fv(loc, count, values);
+    FrameProfiler::countUniform();
+}
+
+void Shader::setInt(const char *name, int value) {
+    setInt(uniform(name), value);
+}
+
+void Shader::setFloat(const char *name, float value) {
+    setFloat(uniform(name), value);
+}
+
+void Shader::setVec3(const char *name, const vec3 vector) {
+    setVec3(uniform(name), vector);
+}
+
+void Shader::setMat4(const char *name, mat4x4 matrix) {
+    setMat4(uniform(name), matrix);
+}
+
+void Shader::setVec3v(const char *name, const std::vector<float>& vectors) {
+    setVec3v(uniform(name), vectors);
+}
+
+void Shader::bindBlock(const char *name, unsigned int binding) {
+    unsigned int index = glGetUniformBlockIndex(program, name);
+    if (index != GL_INVALID_INDEX) glUniformBlockBinding(program, index, binding);
 }
 
 Shader::~Shader() {
@@ -157,10 +346,30 @@ PuzzleRenderer::PuzzleRenderer(Puzzle *puzzle) {
     spacing = 0.0f;
     sensitivity = 0.01f;
     animating = false;
+    animatedMoves.fill(MoveEntry());
+    animatedCount = 0;
     animationProgress = 0.0f;
-    animationSpeed = 4.0f;
+    stateVersion = 0;
+    moveSerial = 0;
+    instancing = true;
+    shaderEdges = false;
+    uniformShader = NULL;
+    sceneDirty = true;
+    gpuAnimationReady = false;
     mat4x4_identity(model);
 
+    std::memset(&sceneUniforms, 0, sizeof(sceneUniforms));
+    mat4x4_identity(sceneUniforms.view);
+    mat4x4_identity(sceneUniforms.projection);
+    for (int i = 0; i < 8; i++) {
+        std::copy(Pieces::colors[i], Pieces::colors[i] + 3, sceneUniforms.palette[i]);
+    }
+    glGenBuffers(1, &sceneUbo);
+    glBindBuffer(GL_UNIFORM_BUFFER, sceneUbo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(SceneUniforms), &sceneUniforms, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    sceneUniformsDirty = false;
+
     meshes[0] = new PieceMesh(Pieces::mesh1c);
     meshes[1] = new PieceMesh(Pieces::mesh2c);
     meshes[2] = new PieceMesh(Pieces::mesh3c);
@@ -171,6 +380,7 @@ PuzzleRenderer::~PuzzleRenderer() {
     for (int i = 0; i < 4; i++) {
         delete meshes[i];
     }
+    glDeleteBuffers(1, &sceneUbo);
 }
 
 float PuzzleRenderer::getSpacing() {
@@ -184,30 +394,122 @@ void PuzzleRenderer::setSpacing(float spacing) {
     } else if (this->spacing > 1.5f) {
         this->spacing = 1.5f;
     }
+    // Instances hold spaced positions
+    sceneDirty = true;
+    gpuAnimationReady = false;
 }
 
-void PuzzleRenderer::render1c(Shader *shader, const std::array<float, 3> pos, Color color) {
+void PuzzleRenderer::setCamera(mat4x4 const view, mat4x4 const projection) {
+    mat4x4_dup(sceneUniforms.view, view);
+    mat4x4_dup(sceneUniforms.projection, projection);
+    sceneUniformsDirty = true;
+}
+
+bool PuzzleRenderer::getShaderEdges() {
+    return shaderEdges;
+}
+
+void PuzzleRenderer::setShaderEdges(bool shaderEdges) {
+    if (this->shaderEdges == shaderEdges) return;
+    this->shaderEdges = shaderEdges;
+    sceneUniforms.shaderEdges = shaderEdges ? 1.0f : 0.0f;
+    sceneUniformsDirty = true;
+}
+
+bool PuzzleRenderer::getInstancing() {
+    return instancing;
+}
+
+void PuzzleRenderer::setInstancing(bool instancing) {
+    this->instancing = instancing;
+    sceneDirty = true;
+    gpuAnimationReady = false;
+}
+
+void PuzzleRenderer::loadUniforms(Shader *shader) {
+    if (shader == uniformShader) return;
+    uniformShader = shader;
+    uniforms.model = shader->uniform("model");
+    uniforms.border = shader->uniform("border");
+    uniforms.outline = shader->uniform("outline");
+    uniforms.instanced = shader->uniform("instanced");
+    uniforms.time = shader->uniform("time");
+    uniforms.pieceColors = shader->uniform("pieceColors");
+    uniforms.animating = shader->uniform("animating");
+    shader->bindBlock("Scene", SCENE_BLOCK_BINDING);
+}
+
+void PuzzleRenderer::uploadSceneUniforms() {
+    // Rebound every time, other code may use the binding in between
+    glBindBufferBase(GL_UNIFORM_BUFFER, SCENE_BLOCK_BINDING, sceneUbo);
+    if (!sceneUniformsDirty) return;
+    glBindBuffer(GL_UNIFORM_BUFFER, sceneUbo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(SceneUniforms), &sceneUniforms);
+    FrameProfiler::countUniform();
+    sceneUniformsDirty = false;
+}
+
+void PuzzleRenderer::renderPiece(Shader *shader, int type, mat4x4 model, const Color *colors, int numColors) {
+    if (instancing) {
+        PieceInstance instance;
+        mat4x4_dup(instance.model, model);
+        for (int i = 0; i < 4; i++) {
+            instance.colors[i] = (i < numColors) ? (float)colors[i] : 0.0f;
+            instance.anim[i] = 0.0f;
+        }
+        instances[type].push_back(instance);
+        return;
+    }
+
+    float pieceColors[4 * 3];
+    for (int i = 0; i < numColors; i++) {
+        std::copy(Pieces::colors[colors[i]], Pieces::colors[colors[i]] + 3, pieceColors + i * 3);
+    }
     shader->use();
-    shader->setVec3("pieceColors[0]", Pieces::colors[color]);
+    shader->setVec3v(uniforms.pieceColors, pieceColors, numColors);
+    shader->setMat4(uniforms.model, model);
+
+    shader->setInt(uniforms.border, 0);
+    meshes[type]->renderFaces();
+    if (shaderEdges) return;
+    shader->setInt(uniforms.border, 1);
+    meshes[type]->renderEdges();
+}
+
+void PuzzleRenderer::flushInstances(Shader *shader) {
+    for (int i = 0; i < 4; i++) {
+        meshes[i]->setInstances(instances[i]);
+        instances[i].clear();
+    }
+    drawInstances(shader);
+}
+
+void PuzzleRenderer::drawInstances(Shader *shader, InstanceBuffer buffer) {
+    shader->use();
+    shader->setInt(uniforms.instanced, 1);
+    uploadSceneUniforms();
+    for (int i = 0; i < 4; i++) {
+        if (meshes[i]->getInstanceCount(buffer) == 0) continue;
+        shader->setInt(uniforms.border, 0);
+        meshes[i]->renderFacesInstanced(buffer);
+        if (shaderEdges) continue;
+        shader->setInt(uniforms.border, 1);
+        meshes[i]->renderEdgesInstanced(buffer);
+    }
+    shader->setInt(uniforms.instanced, 0);
+}
 
+void PuzzleRenderer::render1c(Shader *shader, const std::array<float, 3> pos, Color color) {
     float scale = getSpacing() + 1.0f;
     mat4x4 model;
     mat4x4_dup(model, this->model);
     mat4x4_translate_in_place(model, pos[0], pos[1], pos[2]);
     mat4x4_scale_pos(model, scale);
-    shader->setMat4("model", model);
 
-    shader->setInt("border", 0);
-    meshes[0]->renderFaces(shader);
-    shader->setInt("border", 1);
-    meshes[0]->renderEdges();
+    renderPiece(shader, 0, model, &color, 1);
 }
 
 void PuzzleRenderer::render2c(Shader *shader, const std::array<float, 3> pos, const std::array<Color, 2> colors, CellLocation dir) {
-    shader->use();
-    shader->setVec3("pieceColors[0]", Pieces::colors[colors[0]]);
-    shader->setVec3("pieceColors[1]", Pieces::colors[colors[1]]);
-
     float scale = getSpacing() + 1.0f;
     mat4x4 model;
     mat4x4_dup(model, this->model);
@@ -226,40 +528,20 @@ void PuzzleRenderer::render2c(Shader *shader, const std::array<float, 3> pos, co
             return;
     }
 
-    shader->setMat4("model", model);
-
-    shader->setInt("border", 0);
-    meshes[1]->renderFaces(shader);
-    shader->setInt("border", 1);
-    meshes[1]->renderEdges();
+    renderPiece(shader, 1, model, colors.data(), 2);
 }
 
 void PuzzleRenderer::render3c(Shader *shader, const std::array<float, 3> pos, const std::array<Color, 3> colors) {
-    shader->use();
-    shader->setVec3("pieceColors[0]", Pieces::colors[colors[0]]);
-    shader->setVec3("pieceColors[1]", Pieces::colors[colors[1]]);
-    shader->setVec3("pieceColors[2]", Pieces::colors[colors[2]]);
-
     float scale = getSpacing() + 1.0f;
     mat4x4 model;
     mat4x4_dup(model, this->model);
     mat4x4_translate_in_place(model, pos[0], pos[1], pos[2]);
     mat4x4_scale_pos(model, scale);
-    shader->setMat4("model", model);
 
-    shader->setInt("border", 0);
-    meshes[2]->renderFaces(shader);
-    shader->setInt("border", 1);
-    meshes[2]->renderEdges();
+    renderPiece(shader, 2, model, colors.data(), 3);
 }
 
 void PuzzleRenderer::render4c(Shader *shader, const std::array<float, 3> pos, const std::array<Color, 4> colors, int orientation) {
-    shader->use();
-    shader->setVec3("pieceColors[0]", Pieces::colors[colors[0]]);
-    shader->setVec3("pieceColors[1]", Pieces::colors[colors[1]]);
-    shader->setVec3("pieceColors[2]", Pieces::colors[colors[2]]);
-    shader->setVec3("pieceColors[3]", Pieces::colors[colors[3]]);
-
     float scale = getSpacing() + 1.0f;
     mat4x4 model;
     mat4x4_dup(model, this->model);
@@ -272,12 +554,8 @@ void PuzzleRenderer::render4c(Shader *shader, const std::array<float, 3> pos, co
     } else {
         mat4x4_rotate(model, model, 0, 1, 0, M_PI_2 * orientation);
     }
-    shader->setMat4("model", model);
 
-    shader->setInt("border", 0);
-    meshes[3]->renderFaces(shader);
-    shader->setInt("border", 1);
-    meshes[3]->renderEdges();
+    renderPiece(shader, 3, model, colors.data(), 4);
 }
 
 void PuzzleRenderer::setMousePressed(bool pressed) {
@@ -423,11 +701,24 @@ void PuzzleRenderer::renderMiddleSlice(Shader *shader, bool addOffsetX, float of
 }
 
 void PuzzleRenderer::renderPuzzle(Shader *shader) {
+    loadUniforms(shader);
+    uploadSceneUniforms();
     glLineWidth(2);
-    if (pendingMoves.size() == 0) {
+    if (instancing && animating) {
+        if (gpuAnimationReady || describeAnimation(shader, animatedMoves.data(), animatedCount)) {
+            renderGpuAnimation(shader);
+            return;
+        }
+    } else if (instancing) {
+        if (sceneDirty) updateScene(shader);
+        drawInstances(shader, SCENE_INSTANCES);
+        return;
+    }
+
+    if (!animating) {
         renderNoAnimation(shader);
-    } else if (pendingMoves.front().type == TURN) {
-        MoveEntry move = pendingMoves.front();
+    } else if (animatedMoves[0].type == TURN) {
+        MoveEntry move = animatedMoves[0];
         switch (move.cell) {
             case LEFT: renderLeftAnimation(shader, move.direction); break;
             case RIGHT: renderRightAnimation(shader, move.direction); break;
@@ -438,10 +729,10 @@ void PuzzleRenderer::renderPuzzle(Shader *shader) {
             case UP: renderUpDownAnimation(shader, UP, move.direction); break;
             case DOWN: renderUpDownAnimation(shader, DOWN, move.direction); break;
         }
-    } else if (pendingMoves.front().type == ROTATE) {
-        renderRotateAnimation(shader, pendingMoves.front().direction);
-    } else if (pendingMoves.front().type == GYRO) {
-        MoveEntry move = pendingMoves.front();
+    } else if (animatedMoves[0].type == ROTATE) {
+        renderRotateAnimation(shader, animatedMoves[0].direction);
+    } else if (animatedMoves[0].type == GYRO) {
+        MoveEntry move = animatedMoves[0];
         switch (move.cell) {
             case LEFT:
             case RIGHT:
@@ -456,15 +747,183 @@ void PuzzleRenderer::renderPuzzle(Shader *shader) {
                 renderGyroZAnimation(shader, move.cell);
                 break;
             default:
-                return;
+                break;
         }
-    } else if (pendingMoves.front().type == GYRO_OUTER) {
-        renderOuterGyroAnimation(shader, pendingMoves.front().location);
-    } else if (pendingMoves.front().type == GYRO_MIDDLE) {
-        renderPGyroAnimation(shader, pendingMoves.front().location);
+    } else if (animatedMoves[0].type == GYRO_OUTER) {
+        renderOuterGyroAnimation(shader, animatedMoves[0].location);
+    } else if (animatedMoves[0].type == GYRO_MIDDLE) {
+        renderPGyroAnimation(shader, animatedMoves[0].location);
+    }
+    if (instancing) {
+        flushInstances(shader);
     }
 }
 
+bool PuzzleRenderer::describeAnimation(Shader *shader, const MoveEntry *moves, int count) {
+    for (int i = 0; i < ANIMATION_TRACKS; i++) {
+        tracks[i] = {{0, 0, 0}, {1, 0, 0}, 0.0f};
+    }
+    // Track 0 stays still, pieces on it only follow their bump. Grouped moves
+    // are single track turns, which take the tracks after it in order
+    for (int k = 0; k < count; k++) {
+        if (!describeTracks(moves[k], tracks.data() + k)) return false;
+    }
+
+    float scale = getSpacing() + 1.0f;
+    renderNoAnimation(shader);
+    for (int i = 0; i < 4; i++) {
+        for (size_t j = 0; j < instances[i].size(); j++) {
+            PieceInstance& instance = instances[i][j];
+            vec3 pos = {instance.model[3][0] / scale, instance.model[3][1] / scale, instance.model[3][2] / scale};
+            vec3 bump = {0, 0, 0};
+            int track = 0;
+            // Grouped moves turn disjoint pieces, but every move bumps the rest
+            for (int k = 0; k < count; k++) {
+                vec3 moveBump = {0, 0, 0};
+                int moveTrack = classifyPiece(moves[k], pos, moveBump);
+                vec3_add(bump, bump, moveBump);
+                if (moveTrack != 0) track = moveTrack + k;
+            }
+            std::copy(bump, bump + 3, instance.anim);
+            instance.anim[3] = (float)track;
+        }
+        meshes[i]->setInstances(instances[i]);
+        instances[i].clear();
+    }
+
+    for (int i = 0; i < ANIMATION_TRACKS; i++) {
+        std::copy(tracks[i].pivot, tracks[i].pivot + 3, sceneUniforms.animPivot[i]);
+        sceneUniforms.animPivot[i][3] = tracks[i].angle;
+        std::copy(tracks[i].axis, tracks[i].axis + 3, sceneUniforms.animAxis[i]);
+    }
+    sceneUniformsDirty = true;
+    gpuAnimationReady = true;
+    return true;
+}
+
+bool PuzzleRenderer::describeTracks(const MoveEntry& move, AnimationTrack *base) {
+    int outer = puzzle->outerSlicePos;
+    switch (move.type) {
+        case ROTATE:
+            base[1].angle = ((int)move.direction * 2 - 1) * M_PI_2;
+            break;
+        case TURN:
+            if (move.cell == LEFT || move.cell == RIGHT) {
+                int side = (move.cell == LEFT) ? -1 : 1;
+                base[1].pivot[0] = 2 * side - 0.5f * outer;
+                base[1].axis[0] = 0;
+                base[1].axis[(int)move.direction / 2] = -1 + (int)move.direction % 2 * 2;
+                base[1].angle = M_PI_2;
+            } else if (move.cell == IN || move.cell == OUT) {
+                base[1].angle = ((int)move.direction % 2 * 2 - 1) * M_PI_2;
+            } else {
+                return false;
+            }
+            break;
+        case GYRO_MIDDLE: {
+            if (move.location == 0) return false;
+            // Each arm of the middle slice rolls around its own pivot
+            float x = -0.5f * outer + 2 * puzzle->middleSlicePos + move.location;
+            float angle = move.location * M_PI;
+            base[1] = {{x, 2, 0}, {0, 0, -1}, angle};
+            base[2] = {{x, -2, 0}, {0, 0, -1}, -angle};
+            base[3] = {{x, 0, 2}, {0, 1, 0}, angle};
+            base[4] = {{x, 0, -2}, {0, 1, 0}, -angle};
+            break;
+        }
+        default:
+            return false;
+    }
+    return true;
+}
+
+int PuzzleRenderer::classifyPiece(const MoveEntry& move, const vec3 pos, vec3 bump) {
+    int outer = puzzle->outerSlicePos;
+    int middle = puzzle->middleSlicePos;
+    // Only middle slice pieces stick out of the 3x3 cross section
+    bool inMiddle = std::abs(pos[1]) > 1.5f || std::abs(pos[2]) > 1.5f;
+    vec3 outward = {0, 0, 0};
+    if (std::abs(pos[1]) > 1.5f) {
+        outward[1] = (pos[1] > 0) ? 1 : -1;
+    } else if (std::abs(pos[2]) > 1.5f) {
+        outward[2] = (pos[2] > 0) ? 1 : -1;
+    }
+
+    if (move.type == ROTATE) {
+        return 1;
+    } else if (move.type == GYRO_MIDDLE) {
+        if (!inMiddle) return 0;
+        if (outward[1] != 0) return (outward[1] > 0) ? 1 : 2;
+        return (outward[2] > 0) ? 3 : 4;
+    } else if (move.cell == LEFT || move.cell == RIGHT) {
+        // Matches renderLeftAnimation and renderRightAnimation
+        int side = (move.cell == LEFT) ? -1 : 1;
+        bool near = (outer == -side);
+        float amount = near ? 0.5f : 1.0f;
+        if (!inMiddle && std::abs(pos[0] - (2 * side - 0.5f * outer)) < 1.5f) {
+            if (near) bump[0] = side * amount;
+            return 1;
+        }
+        if (inMiddle && middle == side) {
+            vec3_scale(bump, outward, amount);
+        } else if (!near && ((!inMiddle && side * pos[0] > 3.0f) || (inMiddle && middle == 2 * side))) {
+            bump[0] = side * amount;
+        } else {
+            bump[0] = -side * amount;
+        }
+        return 0;
+    } else {
+        // Matches renderInnerAnimation and renderOuterAnimation
+        float distance = std::abs(pos[0] + 0.5f * outer);
+        if (!inMiddle && ((move.cell == IN) ? distance < 1.5f : distance > 2.5f)) {
+            return 1;
+        }
+        if (inMiddle && middle == ((move.cell == IN) ? 0 : 2 * outer)) {
+            vec3_dup(bump, outward);
+        }
+        return 0;
+    }
+}
+
+void PuzzleRenderer::updateScene(Shader *shader) {
+    renderNoAnimation(shader);
+    for (int i = 0; i < 4; i++) {
+        std::vector<PieceInstance>& scene = sceneInstances[i];
+        const std::vector<PieceInstance>& current = instances[i];
+        if (scene.size() != current.size()) {
+            scene = current;
+            meshes[i]->setInstances(scene, SCENE_INSTANCES);
+        } else {
+            // Slots follow the traversal order, only upload runs that changed
+            size_t j = 0;
+            while (j < scene.size()) {
+                if (std::memcmp(&scene[j], &current[j], sizeof(PieceInstance)) == 0) {
+                    j++;
+                    continue;
+                }
+                size_t start = j;
+                while (j < scene.size() && std::memcmp(&scene[j], &current[j], sizeof(PieceInstance)) != 0) {
+                    scene[j] = current[j];
+                    j++;
+                }
+                meshes[i]->updateInstances(&scene[start], start, j - start, SCENE_INSTANCES);
+            }
+        }
+        instances[i].clear();
+    }
+    sceneDirty = false;
+}
+
+void PuzzleRenderer::renderGpuAnimation(Shader *shader) {
+    shader->use();
+    shader->setInt(uniforms.animating, 1);
+    sceneUniforms.progress = animationProgress;
+    sceneUniforms.scale = getSpacing() + 1.0f;
+    sceneUniformsDirty = true;
+    drawInstances(shader);
+    shader->setInt(uniforms.animating, 0);
+}
+
 void PuzzleRenderer::renderNoAnimation(Shader *shader) {
     float offset = puzzle->outerSlicePos * -0.5f;
     mat4x4_identity(model);
@@ -1128,36 +1587,27 @@ void PuzzleRenderer::renderPGyroPosAnimation(Shader *shader, int direction) {
     }
 }
 
-bool PuzzleRenderer::updateAnimations(GLFWwindow* window, double dt, MoveEntry *entry) {
-    if (pendingMoves.size() == 0) {
-        animating = false;
+void PuzzleRenderer::setFrame(const PuzzleSnapshot& frame) {
+    if (frame.stateVersion != stateVersion) {
+        *puzzle = frame.puzzle;
+        stateVersion = frame.stateVersion;
+        sceneDirty = true;
+        gpuAnimationReady = false;
     }
-    if (animating) {
-        animationProgress += dt * animationSpeed;
-        if (animationProgress > pendingMoves.front().animLength) {
-            MoveEntry lastEntry = pendingMoves.front();
-            pendingMoves.pop();
-            animationProgress = 0.0f;
-            *entry = lastEntry;
-            return true;
-        }
+    if (frame.moveSerial != moveSerial) {
+        // A different move, its tracks are described again
+        moveSerial = frame.moveSerial;
+        gpuAnimationReady = false;
     }
-    return false;
-}
-
-void PuzzleRenderer::scheduleMove(MoveEntry entry) {
-    pendingMoves.push(entry);
-    animating = true;
+    animating = frame.animating;
+    animatedCount = frame.moveCount;
+    std::copy(frame.moves, frame.moves + frame.moveCount, animatedMoves.begin());
+    animationProgress = frame.progress;
 }
 
-void PuzzleRenderer::renderCellOutline(Shader *shader, CellLocation cell) {
-    if (animating) return;
-    shader->use();
-    shader->setInt("border", 0);
-    shader->setInt("outline", 1);
-    shader->setFloat("time", 2 * M_PI * glfwGetTime());
-    glLineWidth(4);
-
+int PuzzleRenderer::getCellBoxes(CellLocation cell, mat4x4 *boxes) {
+    mat4x4 model;
+    int count = 0;
     float offset = puzzle->outerSlicePos * -0.5f;
     float scale = 3.0f + 2 * getSpacing();
     float posScale = 1.0f + getSpacing();
@@ -1172,23 +1622,20 @@ void PuzzleRenderer::renderCellOutline(Shader *shader, CellLocation cell) {
             mat4x4_translate(model, offset, 0, 0);
             mat4x4_scale_pos(model, posScale);
             mat4x4_scale_aniso(model, model, scale, scale, scale);
-            shader->setMat4("model", model);
-            meshes[0]->renderEdges();
+            mat4x4_dup(boxes[count++], model);
             break;
         case OUT:
             offset = puzzle->outerSlicePos * -3.5f;
             mat4x4_translate(model, offset, 0, 0);
             mat4x4_scale_pos(model, posScale);
             mat4x4_scale_aniso(model, model, 1.0f, scale, scale);
-            shader->setMat4("model", model);
-            meshes[0]->renderEdges();
+            mat4x4_dup(boxes[count++], model);
 
             offset = puzzle->outerSlicePos * 3.0f;
             mat4x4_translate(model, offset, 0, 0);
             mat4x4_scale_pos(model, posScale);
             mat4x4_scale_aniso(model, model, 2.0f, scale, scale);
-            shader->setMat4("model", model);
-            meshes[0]->renderEdges();
+            mat4x4_dup(boxes[count++], model);
             break;
         case UP:
         case DOWN:
@@ -1196,27 +1643,23 @@ void PuzzleRenderer::renderCellOutline(Shader *shader, CellLocation cell) {
             mat4x4_translate(model, 0, flip, 0);
             mat4x4_scale_pos(model, posScale);
             mat4x4_scale_aniso(model, model, 8.0f + 7 * getSpacing(), 1.0f, scale);
-            shader->setMat4("model", model);
-            meshes[0]->renderEdges();
+            mat4x4_dup(boxes[count++], model);
 
             offset += 2 * puzzle->middleSlicePos;
             if (puzzle->middleSliceDir == UP) {
                 mat4x4_translate(model, offset, 2.0f * flip, 0);
-            mat4x4_scale_pos(model, posScale);
+                mat4x4_scale_pos(model, posScale);
                 mat4x4_scale_aniso(model, model, 1.0f, 1.0f, scale);
-                shader->setMat4("model", model);
-                meshes[0]->renderEdges();
+                mat4x4_dup(boxes[count++], model);
             } else {
                 mat4x4_translate(model, offset, 2.0f * flip, 0);
                 mat4x4_scale_pos(model, posScale);
-                shader->setMat4("model", model);
-                meshes[0]->renderEdges();
+                mat4x4_dup(boxes[count++], model);
 
                 for (int i = -1; i < 2; i += 2) {
                     mat4x4_translate(model, offset, flip, i * 2);
                     mat4x4_scale_pos(model, posScale);
-                    shader->setMat4("model", model);
-                    meshes[0]->renderEdges();
+                    mat4x4_dup(boxes[count++], model);
                 }
             }
             break;
@@ -1226,30 +1669,80 @@ void PuzzleRenderer::renderCellOutline(Shader *shader, CellLocation cell) {
             mat4x4_translate(model, 0, 0, flip);
             mat4x4_scale_pos(model, posScale);
             mat4x4_scale_aniso(model, model, 8.0f + 7 * getSpacing(), scale, 1.0f);
-            shader->setMat4("model", model);
-            meshes[0]->renderEdges();
+            mat4x4_dup(boxes[count++], model);
 
             offset += 2 * puzzle->middleSlicePos;
             if (puzzle->middleSliceDir == FRONT) {
                 mat4x4_translate(model, offset, 0, 2.0f * flip);
                 mat4x4_scale_pos(model, posScale);
                 mat4x4_scale_aniso(model, model, 1.0f, scale, 1.0f);
-                shader->setMat4("model", model);
-                meshes[0]->renderEdges();
+                mat4x4_dup(boxes[count++], model);
             } else {
                 mat4x4_translate(model, offset, 0, 2.0f * flip);
                 mat4x4_scale_pos(model, posScale);
-                shader->setMat4("model", model);
-                meshes[0]->renderEdges();
+                mat4x4_dup(boxes[count++], model);
 
                 for (int i = -1; i < 2; i += 2) {
                     mat4x4_translate(model, offset, i * 2, flip);
                     mat4x4_scale_pos(model, posScale);
-                    shader->setMat4("model", model);
-                    meshes[0]->renderEdges();
+                    mat4x4_dup(boxes[count++], model);
                 }
             }
             break;
     }
-    shader->setInt("outline", 0);
+    return count;
+}
+
+int PuzzleRenderer::pickCell(const vec3 origin, const vec3 direction) {
+    int picked = -1;
+    float nearest = INFINITY;
+    float pickedVolume = 0.0f;
+    for (int cell = 0; cell < 8; cell++) {
+        mat4x4 boxes[MAX_CELL_BOXES];
+        int count = getCellBoxes((CellLocation)cell, boxes);
+        for (int i = 0; i < count; i++) {
+            // Slab test against the unit cube the box scales
+            float enter = 0.0f, exit = INFINITY, volume = 1.0f;
+            for (int axis = 0; axis < 3 && enter <= exit; axis++) {
+                float half = 0.5f * boxes[i][axis][axis];
+                float low = boxes[i][3][axis] - half - origin[axis];
+                float high = boxes[i][3][axis] + half - origin[axis];
+                volume *= 2 * half;
+                if (std::abs(direction[axis]) < 1e-6f) {
+                    if (low > 0.0f || high < 0.0f) exit = -1.0f;
+                    continue;
+                }
+                float t1 = low / direction[axis], t2 = high / direction[axis];
+                enter = std::max(enter, std::min(t1, t2));
+                exit = std::min(exit, std::max(t1, t2));
+            }
+            if (enter > exit) continue;
+            // Cells share their outer pieces, the larger cell wins where their faces meet
+            if (enter < nearest - 1e-3f || (enter < nearest + 1e-3f && volume > pickedVolume)) {
+                nearest = std::min(nearest, enter);
+                picked = cell;
+                pickedVolume = volume;
+            }
+        }
+    }
+    return picked;
+}
+
+void PuzzleRenderer::renderCellOutline(Shader *shader, CellLocation cell) {
+    if (animating) return;
+    loadUniforms(shader);
+    uploadSceneUniforms();
+    shader->use();
+    shader->setInt(uniforms.border, 0);
+    shader->setInt(uniforms.outline, 1);
+    shader->setFloat(uniforms.time, 2 * M_PI * glfwGetTime());
+    glLineWidth(4);
+
+    mat4x4 boxes[MAX_CELL_BOXES];
+    int count = getCellBoxes(cell, boxes);
+    for (int i = 0; i < count; i++) {
+        shader->setMat4(uniforms.model, boxes[i]);
+        meshes[0]->renderEdges();
+    }
+    shader->setInt(uniforms.outline, 0);
 }
@@ -23,58 +23,115 @@
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 #include <linmath.h>
-#include <queue>
 #include <array>
 #include <vector>
+#include <map>
+#include <string>
 #include "pieces.h"
 #include "puzzle.h"
+#include "move.h"
+#include "sync.h"
 
 class Shader {
     public:
         Shader(const char *vertex, const char *fragment);
         ~Shader();
         void use();
-        void setInt(std::string loc, int value);
-        void setFloat(std::string loc, float value);
-        void setVec3(std::string loc, vec3 vector);
-        void setMat4(std::string loc, mat4x4 matrix);
-        void setVec3v(std::string loc, std::vector<float> vectors);
+        // Cached location of a uniform, -1 if it does not exist
+        int uniform(const char *name);
+        void setInt(int loc, int value);
+        void setFloat(int loc, float value);
+        void setVec3(int loc, const vec3 vector);
+        void setMat4(int loc, mat4x4 matrix);
+        void setVec3v(int loc, const float *vectors, int count);
+        void setVec3v(int loc, const std::vector<float>& vectors);
+        void setFloatv(int loc, const float *values, int count);
+        void setInt(const char *name, int value);
+        void setFloat(const char *name, float value);
+        void setVec3(const char *name, const vec3 vector);
+        void setMat4(const char *name, mat4x4 matrix);
+        void setVec3v(const char *name, const std::vector<float>& vectors);
+        // Points the named uniform block at a buffer binding, if the program has it
+        void bindBlock(const char *name, unsigned int binding);
 
     private:
         unsigned int program;
+        std::map<std::string, int> locations;
+        void loadUniforms();
 };
 
+struct PieceInstance {
+    mat4x4 model;
+    // Indices into Pieces::colors, unused slots are 0
+    float colors[4];
+    // Bump offset (xyz) and animation track (w) for GPU animations
+    float anim[4];
+};
+
+#define ANIMATION_TRACKS 5
+// Most boxes drawn for one cell outline
+#define MAX_CELL_BOXES 4
+
+// Rigid rotation applied on the GPU to every instance assigned to the track
+struct AnimationTrack {
+    vec3 pivot;
+    vec3 axis;
+    float angle;
+};
+
+#define SCENE_BLOCK_BINDING 0
+
+// std140 layout of the Scene block in the model shaders. Uploaded in one
+// call when a draw needs it changed, instead of a uniform call per value
+struct SceneUniforms {
+    mat4x4 view;
+    mat4x4 projection;
+    // Angle in w
+    float animPivot[ANIMATION_TRACKS][4];
+    float animAxis[ANIMATION_TRACKS][4];
+    float palette[8][4];
+    float progress;
+    float scale;
+    float shaderEdges;
+    float padding;
+};
+
+// Persistent instances of the resting puzzle, and per-frame instances
+typedef enum {
+    SCENE_INSTANCES, STREAM_INSTANCES
+} InstanceBuffer;
+
 class PieceMesh {
     public:
         PieceMesh(PieceType type);
-        void renderFaces(Shader* shader);
+        void renderFaces();
         void renderEdges();
+        void setInstances(const std::vector<PieceInstance>& instances, InstanceBuffer buffer = STREAM_INSTANCES);
+        void updateInstances(const PieceInstance *instances, unsigned int offset, unsigned int count, InstanceBuffer buffer);
+        void renderFacesInstanced(InstanceBuffer buffer = STREAM_INSTANCES);
+        void renderEdgesInstanced(InstanceBuffer buffer = STREAM_INSTANCES);
+        unsigned int getInstanceCount(InstanceBuffer buffer = STREAM_INSTANCES);
 
     private:
-        unsigned int vbo, faceVao, edgeVao, faceEbo, edgeEbo;
+        unsigned int faceVbo, edgeVbo, edgeEbo;
+        unsigned int faceVao[2], edgeVao[2], instanceVbo[2];
         unsigned int length1, length2;
-        std::vector<float> normals;
-};
-
-typedef enum {
-    GYRO, TURN, ROTATE, GYRO_OUTER, GYRO_MIDDLE
-} MoveType;
-
-struct MoveEntry {
-    MoveType type;
-    float animLength;
-    CellLocation cell; // for GYRO, TURN
-    RotateDirection direction; // for TURN
-    int location; // for slice gyros (-1/0/1 for middle gyros)
+        unsigned int instanceCount[2], instanceCapacity[2];
 };
 
 class PuzzleRenderer {
     public:
-        friend class PuzzleController;
+        // Draws its own copy of the puzzle, kept up to date by setFrame
         PuzzleRenderer(Puzzle *puzzle);
         ~PuzzleRenderer();
         float getSpacing();
         void setSpacing(float spacing);
+        bool getInstancing();
+        void setInstancing(bool instancing);
+        void setCamera(mat4x4 const view, mat4x4 const projection);
+        // Darkens face borders in the fragment shader instead of drawing edges as lines
+        bool getShaderEdges();
+        void setShaderEdges(bool shaderEdges);
         void render1c(Shader *shader, const std::array<float, 3> pos, Color color);
         void render2c(Shader *shader, const std::array<float, 3> pos, const std::array<Color, 2> colors, CellLocation dir);
         void render3c(Shader *shader, const std::array<float, 3> pos, const std::array<Color, 3> colors);
@@ -85,10 +142,12 @@ class PuzzleRenderer {
         void renderMiddleSlice(Shader *shader, bool addOffsetX, float offsetYZ, CellLocation filter = (CellLocation)-1);
 
         void renderCellOutline(Shader *shader, CellLocation cell);
+        // Cell hit first by the ray, judged against the outline boxes, -1 if none
+        int pickCell(const vec3 origin, const vec3 direction);
         void setMousePressed(bool pressed);
         bool updateMouse(GLFWwindow* window, double dt);
-        bool updateAnimations(GLFWwindow *window, double dt, MoveEntry* entry);
-        void scheduleMove(MoveEntry entry);
+        // Takes the puzzle and animation to draw from a simulation snapshot
+        void setFrame(const PuzzleSnapshot& frame);
 
     private:
         Puzzle *puzzle;
@@ -99,11 +158,46 @@ class PuzzleRenderer {
         float sensitivity;
         float lastY;
         mat4x4 model;
-        std::queue<MoveEntry> pendingMoves;
         bool animating;
-        float animationSpeed;
+        // Several only when they move none of the same pieces, see MoveAnimator
+        std::array<MoveEntry, MAX_ANIMATION_GROUP> animatedMoves;
+        int animatedCount;
         float animationProgress;
+        uint64_t stateVersion;
+        uint64_t moveSerial;
+        bool instancing;
+        bool shaderEdges;
+        std::array<std::vector<PieceInstance>, 4> instances;
+
+        Shader *uniformShader;
+        struct {
+            int model, border, outline, instanced, time;
+            int pieceColors;
+            int animating;
+        } uniforms;
+        unsigned int sceneUbo;
+        SceneUniforms sceneUniforms;
+        bool sceneUniformsDirty;
+
+        bool sceneDirty;
+        std::array<std::vector<PieceInstance>, 4> sceneInstances;
+        bool gpuAnimationReady;
+        std::array<AnimationTrack, ANIMATION_TRACKS> tracks;
+
+        void loadUniforms(Shader *shader);
+        void uploadSceneUniforms();
+        // Model matrices scaling the unit cube to each outline box of the cell
+        int getCellBoxes(CellLocation cell, mat4x4 *boxes);
+        bool describeAnimation(Shader *shader, const MoveEntry *moves, int count);
+        // Fills tracks from base + 1 for one move
+        bool describeTracks(const MoveEntry& move, AnimationTrack *base);
+        int classifyPiece(const MoveEntry& move, const vec3 pos, vec3 bump);
+        void renderGpuAnimation(Shader *shader);
+        void updateScene(Shader *shader);
+        void drawInstances(Shader *shader, InstanceBuffer buffer = STREAM_INSTANCES);
 
+        void renderPiece(Shader *shader, int type, mat4x4 model, const Color *colors, int numColors);
+        void flushInstances(Shader *shader);
         void renderNoAnimation(Shader *shader);
         void renderLeftAnimation(Shader *shader, RotateDirection direction);
         void renderRightAnimation(Shader *shader, RotateDirection direction);
@@ -0,0 +1,119 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+#include "scheduler.h"
+#include <algorithm>
+
+const char *FrameScheduler::syncModeNames[SYNC_MODE_COUNT] = {
+    "Vsync", "Adaptive sync", "Monitor refresh rate"
+};
+
+FrameScheduler& FrameScheduler::get() {
+    static FrameScheduler scheduler;
+    return scheduler;
+}
+
+FrameScheduler::FrameScheduler() {
+    window = NULL;
+    pendingFrames = REDRAW_FRAMES;
+    animating = false;
+    syncMode = SYNC_VSYNC;
+    adaptiveSupported = false;
+}
+
+void FrameScheduler::attach(GLFWwindow *window) {
+    this->window = window;
+#ifndef __EMSCRIPTEN__
+    adaptiveSupported = glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+        glfwExtensionSupported("GLX_EXT_swap_control_tear");
+#endif
+    applySyncMode();
+}
+
+void FrameScheduler::requestRedraw() {
+    pendingFrames = REDRAW_FRAMES;
+}
+
+void FrameScheduler::setAnimating(bool animating) {
+    this->animating = animating;
+}
+
+bool FrameScheduler::isFrameDue() {
+    return animating || pendingFrames > 0;
+}
+
+void FrameScheduler::frameDrawn() {
+    pendingFrames = std::max(pendingFrames - 1, 0);
+}
+
+bool FrameScheduler::waitForFrame(double lastFrame) {
+    glfwPollEvents();
+#ifdef __EMSCRIPTEN__
+    // The browser calls the main loop once per display refresh
+    return false;
+#else
+    bool idle = false;
+    while (!isFrameDue() && !glfwWindowShouldClose(window)) {
+        glfwWaitEvents();
+        idle = true;
+    }
+    if (!idle && syncMode == SYNC_REFRESH_RATE) {
+        double interval = 1.0 / getRefreshRate();
+        while (glfwGetTime() - lastFrame < interval) {
+            glfwWaitEventsTimeout(interval - (glfwGetTime() - lastFrame));
+        }
+    }
+    return idle;
+#endif
+}
+
+SyncMode FrameScheduler::getSyncMode() {
+    return syncMode;
+}
+
+void FrameScheduler::setSyncMode(SyncMode mode) {
+    if (!isSupported(mode)) return;
+    syncMode = mode;
+    applySyncMode();
+}
+
+bool FrameScheduler::isSupported(SyncMode mode) {
+#ifdef __EMSCRIPTEN__
+    // requestAnimationFrame is always synced
+    return mode == SYNC_VSYNC;
+#else
+    return mode != SYNC_ADAPTIVE || adaptiveSupported;
+#endif
+}
+
+void FrameScheduler::applySyncMode() {
+#ifndef __EMSCRIPTEN__
+    // Negative intervals let late swaps tear instead of waiting
+    int interval[SYNC_MODE_COUNT] = {1, -1, 0};
+    glfwSwapInterval(interval[syncMode]);
+#endif
+    requestRedraw();
+}
+
+int FrameScheduler::getRefreshRate() {
+    // Windowed mode has no monitor of its own, the primary one is the best guess
+    GLFWmonitor *monitor = window ? glfwGetWindowMonitor(window) : NULL;
+    if (monitor == NULL) monitor = glfwGetPrimaryMonitor();
+    const GLFWvidmode *mode = monitor ? glfwGetVideoMode(monitor) : NULL;
+    return (mode && mode->refreshRate > 0) ? mode->refreshRate : DEFAULT_REFRESH_RATE;
+}
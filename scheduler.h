@@ -0,0 +1,74 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+// ImGui needs a few frames to settle hover and focus after an input
+#define REDRAW_FRAMES 3
+#define DEFAULT_REFRESH_RATE 60
+
+typedef enum : int {
+    // Swaps wait for the display
+    SYNC_VSYNC,
+    // As above, but a late frame is shown at once instead of waiting another refresh
+    SYNC_ADAPTIVE,
+    // Swaps don't wait, frames are spaced by the monitor refresh rate instead
+    SYNC_REFRESH_RATE,
+    SYNC_MODE_COUNT
+} SyncMode;
+
+// Decides when the window draws. Frames are drawn while something is animating
+// or after a change is requested, otherwise the loop sleeps until the next event
+class FrameScheduler {
+    public:
+        static FrameScheduler& get();
+        static const char *syncModeNames[SYNC_MODE_COUNT];
+        // Needs the window's context to be current
+        void attach(GLFWwindow *window);
+        // Draws the next few frames, for input and other one-off changes
+        void requestRedraw();
+        // Set every frame, keeps drawing without sleeping while true
+        void setAnimating(bool animating);
+        bool isFrameDue();
+        void frameDrawn();
+        // Processes events, sleeping until one arrives when no frame is due,
+        // or until the next refresh when swaps don't wait. True if it slept idle
+        bool waitForFrame(double lastFrame);
+
+        SyncMode getSyncMode();
+        void setSyncMode(SyncMode mode);
+        bool isSupported(SyncMode mode);
+        // Swap interval is lost when switching to and from fullscreen
+        void applySyncMode();
+        int getRefreshRate();
+
+    private:
+        FrameScheduler();
+        GLFWwindow *window;
+        int pendingFrames;
+        bool animating;
+        SyncMode syncMode;
+        bool adaptiveSupported;
+};
+
+#endif // scheduler.h
@@ -0,0 +1,104 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+#include "simulation.h"
+#include "solver.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Usage: scrambler [count] [length] [seed] [-s]
+// Writes each scramble as its own YAML document. Loaded as a log, the output
+// gives the first scramble, split it up to load the others.
+// With -s, scrambles are the solver's moves to the state a random walk of length
+// moves reaches, at most length moves from solved
+
+#define OUTPUT_BUFFER (1 << 20)
+
+static const char *const HSC_KEY = "scramble: >\n  ";
+static const char *const PHYS_KEY = "phys_scramble: >\n  ";
+
+// Buffer always has room for one more scramble
+static void append(std::vector<char>& buffer, size_t& used, const char *text, size_t length) {
+    std::memcpy(&buffer[used], text, length);
+    used += length;
+}
+
+int main(int argc, char *argv[]) {
+    bool state = false;
+    std::vector<const char*> values;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "-s") == 0) {
+            state = true;
+        } else {
+            values.push_back(argv[i]);
+        }
+    }
+    long count = (values.size() > 0) ? std::atol(values[0]) : 1000;
+    int length = (values.size() > 1) ? std::atoi(values[1]) : (state ? 6 : 45);
+    PuzzleSimulation simulation;
+    if (values.size() > 2) simulation.seed(std::atoi(values[2]));
+    if (length <= 0) length = 45;
+
+    Solver solver;
+    solver.loadPatterns("patterns.pdb");
+    std::vector<MoveEntry> moves(MAX_SCRAMBLE_MOVES(length));
+    size_t largest = 2 * MAX_FORMATTED_SCRAMBLE(moves.size()) + std::strlen(HSC_KEY) + std::strlen(PHYS_KEY) + 6;
+    std::vector<char> buffer(OUTPUT_BUFFER + largest);
+    size_t used = 0;
+    int failed = 0;
+    for (long i = 0; i < count; i++) {
+        const MoveEntry *scramble = moves.data();
+        size_t size;
+        if (state) {
+            if (!simulation.generateStateScramble(solver, length)) {
+                failed++;
+                continue;
+            }
+            scramble = simulation.getScramble().data();
+            size = simulation.getScramble().size();
+        } else {
+            size = simulation.generateScramble(length, moves.data());
+        }
+
+        append(buffer, used, "---\n", 4);
+        // Physical moves have no HSC notation, so the key is dropped again
+        size_t key = used;
+        append(buffer, used, HSC_KEY, std::strlen(HSC_KEY));
+        size_t hsc = PuzzleSimulation::formatHscScramble(scramble, size, &buffer[used]);
+        if (hsc) {
+            used += hsc;
+            buffer[used++] = '\n';
+        } else {
+            used = key;
+        }
+        append(buffer, used, PHYS_KEY, std::strlen(PHYS_KEY));
+        used += PuzzleSimulation::formatPhysScramble(scramble, size, &buffer[used]);
+        buffer[used++] = '\n';
+        if (used >= OUTPUT_BUFFER) {
+            std::fwrite(buffer.data(), 1, used, stdout);
+            used = 0;
+        }
+    }
+    std::fwrite(buffer.data(), 1, used, stdout);
+    if (failed) {
+        std::fprintf(stderr, "Solver gave up on %d states\n", failed);
+    }
+    return 0;
+}
@@ -20,84 +20,145 @@
 #include "shaders.h"
 
 #ifdef __EMSCRIPTEN__
-const char *Shaders::modelVertex = "#version 300 es"
+#define MODEL_VERSION "#version 300 es"
 #else
-const char *Shaders::modelVertex = "#version 330 core"
+#define MODEL_VERSION "#version 330 core"
 #endif
-R"(
+
+const char *Shaders::modelVertex = MODEL_VERSION R"(
 precision mediump float;
 precision mediump int;
+#define LIGHTING
+const vec3 lightDir = vec3(-0.3, -0.7, -0.5);
+const vec3 lightColor = vec3(1.0, 1.0, 1.0);
+
+// Layout matches SceneUniforms, repeated in the fragment shader
+layout (std140) uniform Scene {
+    mat4 view;
+    mat4 projection;
+    // Angle in w
+    vec4 animPivot[5];
+    vec4 animAxis[5];
+    vec4 palette[8];
+    float progress;
+    float scale;
+    float shaderEdges;
+};
+
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in float aColIdx;
-out float colorIndex;
+layout (location = 2) in mat4 aModel;
+layout (location = 6) in vec4 aColors;
+layout (location = 7) in vec3 aNormal;
+layout (location = 8) in vec4 aAnim;
+layout (location = 9) in vec3 aEdge;
+// Every vertex of a face has the same colour slot, so one lookup per vertex
+// leaves the fragment shader nothing to select
+flat out vec3 objectColor;
+out vec3 edgeCoord;
+#if defined(NORMAL_MAP)
 out vec3 meshPos;
+flat out vec3 faceNormal;
+flat out mat3 modelRotation;
+#elif defined(LIGHTING)
+// Faces are flat, so their light only needs working out once
+flat out float faceLight;
+#endif
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 uniform int outline;
+uniform int instanced;
+uniform int animating;
+uniform vec3 pieceColors[4];
+
+mat3 rotationMatrix(vec3 axis, float angle) {
+    float c = cos(angle);
+    float s = sin(angle);
+    mat3 crossMatrix = mat3(0.0, axis.z, -axis.y, -axis.z, 0.0, axis.x, axis.y, -axis.x, 0.0);
+    return outerProduct(axis, axis) * (1.0 - c) + mat3(c) + crossMatrix * s;
+}
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    mat4 pieceModel = (instanced == 1) ? aModel : model;
+    if (instanced == 1 && animating == 1) {
+        // Rotate about the track pivot and add the bump, scaled by the spacing.
+        // Progress stays linear like the CPU functions for these moves, only
+        // the two-phase gyros and turns ease, and those never reach this path
+        int track = int(aAnim.w);
+        mat3 rotation = rotationMatrix(animAxis[track].xyz, animPivot[track].w * progress);
+        vec3 pivot = animPivot[track].xyz * scale;
+        vec3 bump = aAnim.xyz * scale * 4.0 * progress * (1.0 - progress);
+        vec3 position = pivot + bump + rotation * (aModel[3].xyz - pivot);
+        pieceModel = mat4(rotation * mat3(aModel));
+        pieceModel[3] = vec4(position, 1.0);
+    }
+    gl_Position = projection * view * pieceModel * vec4(aPos, 1.0);
     if (outline == 1) {
         gl_Position.z -= 1e-4;
     }
-    colorIndex = aColIdx;
+    edgeCoord = aEdge;
+    int slot = int(aColIdx + 0.5);
+    if (instanced == 1) {
+        objectColor = palette[int(aColors[slot])].rgb;
+    } else {
+        objectColor = pieceColors[slot];
+    }
+#if defined(NORMAL_MAP)
     meshPos = aPos;
+    faceNormal = aNormal;
+    modelRotation = mat3(pieceModel);
+#elif defined(LIGHTING)
+    faceLight = max(dot(mat3(pieceModel) * aNormal, normalize(-lightDir)), 0.0);
+#endif
 }
 )";
 
-#ifdef __EMSCRIPTEN__
-const char *Shaders::modelFragment = "#version 300 es"
-#else
-const char *Shaders::modelFragment = "#version 330 core"
-#endif
-R"(
+const char *Shaders::modelFragment = MODEL_VERSION R"(
 precision mediump float;
 precision mediump int;
-#define MAX_TRIANGLES 36
-in float colorIndex;
+#define LIGHTING
+const vec3 lightDir = vec3(-0.3, -0.7, -0.5);
+const vec3 lightColor = vec3(1.0, 1.0, 1.0);
+
+layout (std140) uniform Scene {
+    mat4 view;
+    mat4 projection;
+    // Angle in w
+    vec4 animPivot[5];
+    vec4 animAxis[5];
+    vec4 palette[8];
+    float progress;
+    float scale;
+    float shaderEdges;
+};
+
+flat in vec3 objectColor;
+in vec3 edgeCoord;
+#if defined(NORMAL_MAP)
 in vec3 meshPos;
+flat in vec3 faceNormal;
+flat in mat3 modelRotation;
+#elif defined(LIGHTING)
+flat in float faceLight;
+#endif
 out vec4 FragColor;
 
 uniform int border;
 uniform int outline;
 uniform float time;
-uniform vec3 pieceColors[4];
-
-uniform mat4 model;
-uniform vec3[MAX_TRIANGLES] normals;
 
-vec3 lightDir = vec3(-0.3f, -0.7f, -0.5f);
-vec3 lightColor = vec3(1.0f, 1.0f, 1.0f);
-)"
-#ifndef __EMSCRIPTEN__
-"#define LIGHTING"
-#endif
-R"(
 void main() {
     if (border == 1) {
         FragColor = vec4(vec3(0.0f), 1.0f);
     } else if (outline == 1) {
         FragColor = vec4(vec3(0.7 + 0.3 * sin(time)), 1.0f);
     }  else {
-        vec3 objectColor;
-        if (abs(colorIndex - 0.0f) < 0.002f) {
-            objectColor = pieceColors[0];
-        } else if (abs(colorIndex - 1.0f) < 0.002f) {
-            objectColor = pieceColors[1];
-        } else if (abs(colorIndex - 2.0f) < 0.002f) {
-            objectColor = pieceColors[2];
-        } else if (abs(colorIndex - 3.0f) < 0.002f) {
-            objectColor = pieceColors[3];
-        }
-
 #if defined(LIGHTING)
 #if defined(NORMAL_MAP)
         vec2 texCoord;
         vec3 tangent;
         vec3 bitangent;
-        vec3 meshNormal = normals[gl_PrimitiveID];
+        vec3 meshNormal = faceNormal;
         vec3 surfacePos = meshPos - meshNormal;
         if (abs(meshNormal.x) == 1.0f) {
             texCoord = vec2(surfacePos.z * -meshNormal.x, surfacePos.y);
@@ -114,22 +175,28 @@ void main() {
 
         vec3 normalMap = normalize(vec3(0.1 - texCoord.x / 10, 0.1 - texCoord.y / 10, 1.0));
         mat3 TBN = mat3(tangent, bitangent, meshNormal);
-        vec3 normal = mat3(model) * TBN * normalMap;
+        vec3 normal = modelRotation * TBN * normalMap;
+        float diff = max(dot(normal, normalize(-lightDir)), 0.0);
 #else
-        vec3 normal = mat3(model) * normals[gl_PrimitiveID];
+        float diff = faceLight;
 #endif
 
         float ambientStrength = 0.8;
         vec3 ambient = ambientStrength * lightColor;
 
-        float diff = max(dot(normal, normalize(-lightDir)), 0.0);
         vec3 diffuse = diff * lightColor;
 
         vec3 result = (ambient + diffuse * 0.5) * objectColor;
-        FragColor = vec4(result, 1.0);
 #else
-        FragColor = vec4(objectColor, 1.0);
+        vec3 result = objectColor;
 #endif
+        if (shaderEdges == 1.0) {
+            // Pixels to the nearest mesh edge, each face draws its half of the line
+            vec3 pixels = edgeCoord / max(fwidth(edgeCoord), vec3(1e-5));
+            float distance = min(min(pixels.x, pixels.y), pixels.z);
+            result *= smoothstep(0.5, 1.5, distance);
+        }
+        FragColor = vec4(result, 1.0);
     }
 }
 )";
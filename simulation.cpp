@@ -0,0 +1,794 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+#include "simulation.h"
+#include "movetable.h"
+#include "solver.h"
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+// Parse errors throw instead of aborting
+#define RYML_DEFAULT_CALLBACK_USES_EXCEPTIONS
+#define RYML_SINGLE_HDR_DEFINE_NOW
+#include <rapidyaml-0.6.0.hpp>
+
+PuzzleSimulation::PuzzleSimulation() {
+    puzzle = new Puzzle();
+    ownsPuzzle = true;
+    history = new MoveHistory();
+    history->setStart(PackedPuzzle(*puzzle));
+    std::random_device rd;
+    rng.seed(rd());
+}
+
+PuzzleSimulation::PuzzleSimulation(Puzzle *puzzle) {
+    this->puzzle = puzzle;
+    ownsPuzzle = false;
+    history = new MoveHistory();
+    history->setStart(PackedPuzzle(*puzzle));
+    std::random_device rd;
+    rng.seed(rd());
+}
+
+PuzzleSimulation::~PuzzleSimulation() {
+    delete history;
+    if (ownsPuzzle) {
+        delete puzzle;
+    }
+}
+
+Puzzle* PuzzleSimulation::getPuzzle() {
+    return puzzle;
+}
+
+MoveHistory* PuzzleSimulation::getHistory() {
+    return history;
+}
+
+void PuzzleSimulation::seed(unsigned int seed) {
+    rng.seed(seed);
+}
+
+// Branches on the configuration, only run while building the table
+static GyroExpansion computeGyroExpansion(CellLocation cell, int outerSlicePos, int middleSlicePos, CellLocation middleSliceDir) {
+    GyroExpansion expansion;
+    expansion.count = 0;
+    MoveEntry entry;
+    int direction = 0;
+    switch (cell) {
+        case LEFT:
+        case RIGHT:
+            entry.type = GYRO;
+            entry.animLength = 4.0f;
+            entry.cell = cell;
+            expansion.moves[expansion.count++] = entry;
+            break;
+        case UP:
+        case DOWN:
+        case FRONT:
+        case BACK:
+            if ((cell == UP || cell == DOWN) && middleSliceDir == FRONT) {
+                entry.type = GYRO_MIDDLE;
+                entry.animLength = 1.0f;
+                entry.location = 0;
+                expansion.moves[expansion.count++] = entry;
+            } else if ((cell == FRONT || cell == BACK) && middleSliceDir == UP) {
+                entry.type = GYRO_MIDDLE;
+                entry.animLength = 1.0f;
+                entry.location = 0;
+                expansion.moves[expansion.count++] = entry;
+            }
+
+            if (middleSlicePos == 0) {
+                direction = outerSlicePos;
+            } else if (middleSlicePos == 2 * outerSlicePos) {
+                direction = -outerSlicePos;
+            } else if (middleSlicePos == -outerSlicePos) {
+                entry.type = GYRO_OUTER;
+                entry.animLength = 2.0f;
+                entry.location = -1 * outerSlicePos;
+                expansion.moves[expansion.count++] = entry;
+                direction = 0;
+            } else if (middleSlicePos == outerSlicePos) {
+                direction = 0;
+            }
+
+            if (direction != 0) {
+                entry.type = GYRO_MIDDLE;
+                entry.animLength = 1.0f;
+                entry.location = direction;
+                expansion.moves[expansion.count++] = entry;
+            }
+
+            entry.type = GYRO;
+            entry.animLength = 3.0f;
+            entry.cell = cell;
+            expansion.moves[expansion.count++] = entry;
+            break;
+        case IN:
+        case OUT:
+            break;
+    }
+    return expansion;
+}
+
+static std::array<std::array<GyroExpansion, CONFIG_COUNT>, 8> buildGyroTable() {
+    std::array<std::array<GyroExpansion, CONFIG_COUNT>, 8> table;
+    for (int cell = 0; cell < 8; cell++) {
+        for (int config = 0; config < CONFIG_COUNT; config++) {
+            int outerSlicePos, middleSlicePos;
+            CellLocation middleSliceDir;
+            PackedPuzzle::decodeConfig(config, outerSlicePos, middleSlicePos, middleSliceDir);
+            table[cell][config] = computeGyroExpansion((CellLocation)cell, outerSlicePos, middleSlicePos, middleSliceDir);
+        }
+    }
+    return table;
+}
+
+const GyroExpansion& PuzzleSimulation::getGyroExpansion(CellLocation cell, int config) {
+    static const std::array<std::array<GyroExpansion, CONFIG_COUNT>, 8> table = buildGyroTable();
+    return table[cell][config];
+}
+
+// The gyro as the controller made it before the table, straight on the Puzzle.
+// Setup moves only change the slice configuration, then the cell is gyroed
+static void replayGyro(Puzzle& puzzle, CellLocation cell) {
+    if (cell == LEFT || cell == RIGHT) {
+        puzzle.gyroCell(cell);
+        return;
+    }
+    int outerSlicePos, middleSlicePos;
+    CellLocation middleSliceDir;
+    PackedPuzzle::decodeConfig(PackedPuzzle::puzzleConfig(puzzle), outerSlicePos, middleSlicePos, middleSliceDir);
+    if (((cell == UP || cell == DOWN) && middleSliceDir == FRONT) ||
+        ((cell == FRONT || cell == BACK) && middleSliceDir == UP)) {
+        puzzle.gyroMiddleSlice(0);
+    }
+    if (middleSlicePos == 0) {
+        puzzle.gyroMiddleSlice(outerSlicePos);
+    } else if (middleSlicePos == 2 * outerSlicePos) {
+        puzzle.gyroMiddleSlice(-outerSlicePos);
+    } else if (middleSlicePos == -outerSlicePos) {
+        puzzle.gyroOuterSlice();
+    }
+    puzzle.gyroCell(cell);
+}
+
+bool PuzzleSimulation::verifyGyroExpansions() {
+    const MoveTable& table = MoveTable::get();
+    for (int cell = RIGHT; cell <= BACK; cell++) {
+        for (int config = 0; config < CONFIG_COUNT; config++) {
+            const GyroExpansion& expansion = getGyroExpansion((CellLocation)cell, config);
+            if (expansion.count == 0) return false;
+            const MoveEntry& last = expansion.moves[expansion.count - 1];
+            if (last.type != GYRO || last.cell != cell) return false;
+
+            // Turned a little first, a gyro of the solved puzzle only recolours it
+            Puzzle start;
+            PackedPuzzle packed;
+            packed.setConfig(config);
+            packed.toPuzzle(start);
+            for (int move = 0; move < 24; move += 5) {
+                const MoveEntry& entry = table.moveEntry(move);
+                if (MoveTable::canApply(start, entry)) MoveTable::applyToPuzzle(start, entry);
+            }
+
+            // Every move legal on the Puzzle and through the table
+            Puzzle puzzle = start;
+            PackedPuzzle state(start);
+            for (int i = 0; i < expansion.count; i++) {
+                if (!MoveTable::canApply(puzzle, expansion.moves[i])) return false;
+                if (i == expansion.count - 1) {
+                    // The setup left every sticker alone, the gyro is of the cell asked for
+                    Puzzle expected = puzzle;
+                    expected.gyroCell((CellLocation)cell);
+                    PackedPuzzle setup(puzzle), before(start);
+                    before.setConfig(setup.getConfig());
+                    if (setup != before) return false;
+                    MoveTable::applyToPuzzle(puzzle, expansion.moves[i]);
+                    if (PackedPuzzle(puzzle) != PackedPuzzle(expected)) return false;
+                } else {
+                    MoveTable::applyToPuzzle(puzzle, expansion.moves[i]);
+                }
+                if (!table.apply(state, table.moveIndex(expansion.moves[i]))) return false;
+            }
+
+            Puzzle replayed = start;
+            replayGyro(replayed, (CellLocation)cell);
+            if (state != PackedPuzzle(replayed) || state != PackedPuzzle(puzzle)) return false;
+        }
+    }
+    return true;
+}
+
+std::vector<MoveEntry> PuzzleSimulation::expandGyro(CellLocation cell) {
+    const GyroExpansion& expansion = getGyroExpansion(cell, PackedPuzzle::puzzleConfig(*puzzle));
+    return std::vector<MoveEntry>(expansion.moves, expansion.moves + expansion.count);
+}
+
+std::vector<MoveEntry> PuzzleSimulation::expandCellMove(CellLocation cell, RotateDirection direction) {
+    std::vector<MoveEntry> moves;
+    MoveEntry entry;
+    if ((cell == UP || cell == DOWN) && puzzle->middleSliceDir == FRONT) {
+        entry.type = GYRO_MIDDLE;
+        entry.animLength = 1.0f;
+        entry.location = 0;
+        moves.push_back(entry);
+    } else if ((cell == FRONT || cell == BACK) && puzzle->middleSliceDir == UP) {
+        entry.type = GYRO_MIDDLE;
+        entry.animLength = 1.0f;
+        entry.location = 0;
+        moves.push_back(entry);
+    }
+
+    float length;
+    if (cell == UP || cell == DOWN || cell == FRONT || cell == BACK) {
+        length = 2.0f;
+    } else {
+        length = 1.0f;
+    }
+
+    entry.type = TURN;
+    entry.animLength = length;
+    entry.cell = cell;
+    entry.direction = direction;
+    moves.push_back(entry);
+    return moves;
+}
+
+std::vector<MoveEntry> PuzzleSimulation::expandMove(MoveEntry entry) {
+    if (entry.type == GYRO) {
+        return expandGyro(entry.cell);
+    } else if (entry.type == TURN) {
+        return expandCellMove(entry.cell, entry.direction);
+    }
+    // Rotations and slice gyros are physical moves already
+    return std::vector<MoveEntry>(1, entry);
+}
+
+void PuzzleSimulation::performMove(MoveEntry entry) {
+    MoveTable::applyToPuzzle(*puzzle, entry);
+}
+
+void PuzzleSimulation::applyMove(MoveEntry entry) {
+    if (entry.type == GYRO) {
+        // Copied since moves change the configuration it was looked up by
+        GyroExpansion expansion = getGyroExpansion(entry.cell, PackedPuzzle::puzzleConfig(*puzzle));
+        for (int i = 0; i < expansion.count; i++) {
+            performMove(expansion.moves[i]);
+        }
+        return;
+    }
+    // Expansion reads the configuration, so finish it before moving
+    std::vector<MoveEntry> moves = expandMove(entry);
+    for (size_t i = 0; i < moves.size(); i++) {
+        performMove(moves[i]);
+    }
+}
+
+void PuzzleSimulation::applyMovesImmediate(const MoveEntry *moves, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        applyMove(moves[i]);
+    }
+    history->reset();
+    history->setStart(PackedPuzzle(*puzzle));
+}
+
+void PuzzleSimulation::applyMovesImmediate(const std::vector<MoveEntry>& moves) {
+    applyMovesImmediate(moves.data(), moves.size());
+}
+
+void PuzzleSimulation::reset() {
+    puzzle->resetPuzzle();
+    scramble.clear();
+    history->reset();
+    history->setStart(PackedPuzzle(*puzzle));
+}
+
+bool PuzzleSimulation::seek(size_t index) {
+    if (!history->getCheckpointCount()) {
+        return false;
+    }
+    index = std::min(index, history->getLength());
+    size_t checkpoint = std::min(index / CHECKPOINT_INTERVAL, history->getCheckpointCount() - 1);
+    history->getCheckpoint(checkpoint).toPuzzle(*puzzle);
+    for (size_t i = checkpoint * CHECKPOINT_INTERVAL; i < index; i++) {
+        performMove(history->getTimelineMove(i));
+        // Checkpoints past the last one are filled in as they are passed
+        if ((i + 1) % CHECKPOINT_INTERVAL == 0 && (i + 1) / CHECKPOINT_INTERVAL == history->getCheckpointCount()) {
+            history->addCheckpoint(PackedPuzzle(*puzzle));
+        }
+    }
+    history->seek(index);
+    return true;
+}
+
+void rotate4in8(std::array<int, 8>& cells, std::array<int, 4> indices) {
+    int temp = cells[indices[0]];
+    for (int i = 0; i < 3; i++) {
+        cells[indices[i]] = cells[indices[i + 1]];
+    }
+    cells[indices[3]] = temp;
+}
+
+void rotate8bycell(std::array<int, 8>& cells, CellLocation cell) {
+    if (cell == RIGHT) {
+        rotate4in8(cells, {0, 6, 1, 7});
+    } else if (cell == LEFT) {
+        rotate4in8(cells, {1, 6, 0, 7});
+    } else if (cell == UP) {
+        rotate4in8(cells, {2, 6, 3, 7});
+    } else if (cell == DOWN) {
+        rotate4in8(cells, {3, 6, 2, 7});
+    } else if (cell == FRONT) {
+        rotate4in8(cells, {4, 6, 5, 7});
+    } else if (cell == BACK) {
+        rotate4in8(cells, {5, 6, 4, 7});
+    }
+}
+
+ScrambleRandom::ScrambleRandom() {
+    seed(0);
+}
+
+void ScrambleRandom::seed(uint64_t seed) {
+    // SplitMix64 spreads any seed over the whole state
+    for (int i = 0; i < 4; i++) {
+        seed += 0x9E3779B97F4A7C15ULL;
+        uint64_t z = seed;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        state[i] = z ^ (z >> 31);
+    }
+}
+
+static inline uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+uint64_t ScrambleRandom::next() {
+    uint64_t result = rotl(state[1] * 5, 7) * 9;
+    uint64_t t = state[1] << 17;
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= t;
+    state[3] = rotl(state[3], 45);
+    return result;
+}
+
+uint32_t ScrambleRandom::below(uint32_t bound) {
+    // Multiply and shift, the bias is far below anything a scramble could show
+    return (uint32_t)(((next() >> 32) * bound) >> 32);
+}
+
+size_t PuzzleSimulation::generateScramble(int scrambleLength, MoveEntry *moves) {
+    // Turned cell weighted 2:2:6:6:1:1:1:1 by IN, OUT, RIGHT, LEFT, UP, DOWN, FRONT, BACK
+    static const CellLocation turnCells[20] = {
+        IN, IN, OUT, OUT, RIGHT, RIGHT, RIGHT, RIGHT, RIGHT, RIGHT,
+        LEFT, LEFT, LEFT, LEFT, LEFT, LEFT, UP, DOWN, FRONT, BACK
+    };
+    MoveEntry entry;
+    entry.type = TURN;
+    size_t count = 0;
+    CellLocation lastCell = (CellLocation)-1;
+    for (int i = 0; i < scrambleLength; i++) {
+        // Gyros two times in five
+        if (rng.below(5) < 2 && entry.type != GYRO) {
+            // don't include gyros in scramble length
+            i--;
+            entry.type = GYRO;
+            entry.cell = (CellLocation)(2 + rng.below(6));
+        } else {
+            entry.type = TURN;
+            while (true) {
+                entry.cell = turnCells[rng.below(20)];
+                if (entry.cell != lastCell) break;
+                if (entry.cell == LEFT || entry.cell == RIGHT) break;
+            }
+            lastCell = entry.cell;
+            switch (entry.cell) {
+                case IN:
+                case OUT:
+                    // YZ or ZY
+                    entry.direction = (RotateDirection)rng.below(2);
+                    break;
+                case UP:
+                case DOWN:
+                    // XZ or ZX
+                    entry.direction = (RotateDirection)(2 + rng.below(2));
+                    break;
+                case FRONT:
+                case BACK:
+                    // XY or YX
+                    entry.direction = (RotateDirection)(4 + rng.below(2));
+                    break;
+                case LEFT:
+                case RIGHT:
+                    // any
+                    entry.direction = (RotateDirection)rng.below(6);
+                    break;
+            }
+        }
+        moves[count++] = entry;
+    }
+    return count;
+}
+
+const std::vector<MoveEntry>& PuzzleSimulation::generateScramble(int scrambleLength) {
+    if (scrambleLength == 0) {
+        scrambleLength = 45;
+    }
+    scramble.resize(MAX_SCRAMBLE_MOVES(scrambleLength));
+    scramble.resize(generateScramble(scrambleLength, scramble.data()));
+    MoveEntry entry;
+
+    bool reorient = false;
+    if (reorient) {
+        // R, L, U, D, F, B, O, I
+        // Reorient to HSC default orientation
+        std::array<int, 8> cells = {0, 1, 4, 5, 3, 2, 6, 7};
+        for (size_t i = 0; i < scramble.size(); i++) {
+            if (scramble[i].type == GYRO) {
+                rotate8bycell(cells, scramble[i].cell);
+            }
+        }
+        entry.type = GYRO;
+        std::array<int, 3> colorsToFix = {4, 2, 7};
+        for (int i = 0; i < 3; i++) {
+            int index = std::distance(cells.begin(), std::find(cells.begin(), cells.end(), colorsToFix[i]));
+            if (index != colorsToFix[i]) {
+                // Move to I
+                if (index == 6) {
+                    entry.cell = LEFT;
+                    scramble.push_back(entry);
+                    scramble.push_back(entry);
+                    rotate8bycell(cells, entry.cell);
+                    rotate8bycell(cells, entry.cell);
+                } else if (index < 6) {
+                    entry.cell = (CellLocation)(2 + index);
+                    scramble.push_back(entry);
+                    rotate8bycell(cells, entry.cell);
+                }
+                // Move to desired location (gyro opposite)
+                if (colorsToFix[i] != 7) {
+                    // Don't gyro if inner
+                    entry.cell = (CellLocation)(2 + colorsToFix[i] + 1);
+                    scramble.push_back(entry);
+                    rotate8bycell(cells, entry.cell);
+                }
+            }
+        }
+    }
+
+    return scramble;
+}
+
+bool PuzzleSimulation::generateStateScramble(Solver& solver, int depth) {
+    const MoveTable& table = MoveTable::get();
+    PackedPuzzle solved((Puzzle()));
+    PackedPuzzle state = solved;
+    // Rotating the whole puzzle scrambles nothing
+    for (int i = 0; i < depth;) {
+        int move = (int)rng.below(MOVE_COUNT);
+        if (table.moveEntry(move).type == ROTATE) continue;
+        i += table.apply(state, move);
+    }
+    // Every piece, so the solution reaches exactly this state
+    std::vector<int> pieces(PackedPuzzle::pieceSizes().size());
+    for (size_t i = 0; i < pieces.size(); i++) {
+        pieces[i] = (int)i;
+    }
+    std::vector<MoveEntry> moves;
+    solver.setRotations(false);
+    bool found = solver.solve(solved, state, pieces, depth, moves, true);
+    solver.setRotations(true);
+    if (!found) {
+        return false;
+    }
+    scramble = moves;
+    return true;
+}
+
+const std::vector<MoveEntry>& PuzzleSimulation::getScramble() {
+    return scramble;
+}
+
+bool PuzzleSimulation::loadScramble(std::string filename) {
+    std::ifstream file(filename);
+    if (file.fail()) {
+        return false;
+    }
+    file >> std::ws;
+    std::vector<std::array<int, 2>> moves;
+    std::array<int, 2> move;
+    char comma;
+    while (true) {
+        file >> move[0] >> comma >> move[1];
+        if (file.eof()) {
+            break;
+        }
+        if (comma == ',') {
+            moves.push_back(move);
+        }
+    }
+    MoveEntry entry;
+    for (size_t i = 0; i < moves.size(); i++) {
+        entry.cell = (CellLocation)moves[i][0];
+        if (moves[i][1] == -1) {
+            entry.type = GYRO;
+        } else {
+            entry.type = TURN;
+            entry.direction = (RotateDirection)moves[i][1];
+        }
+        scramble.push_back(entry);
+    }
+    applyMovesImmediate(scramble);
+    return true;
+}
+
+float PuzzleSimulation::getAnimLength(MoveEntry entry) {
+    switch (entry.type) {
+        case TURN:
+            return (entry.cell == UP || entry.cell == DOWN || entry.cell == FRONT || entry.cell == BACK) ? 2.0f : 1.0f;
+        case GYRO:
+            return (entry.cell == LEFT || entry.cell == RIGHT) ? 4.0f : 3.0f;
+        case GYRO_OUTER:
+            return 2.0f;
+        default:
+            return 1.0f;
+    }
+}
+
+// Reads "a,b" integer pairs from the scalar without copying it
+static bool parsePairs(ryml::csubstr text, std::vector<std::array<int, 2>>& pairs) {
+    size_t i = 0;
+    while (true) {
+        while (i < text.len && (text[i] == ' ' || text[i] == '\n' || text[i] == '\r' || text[i] == '\t')) i++;
+        if (i == text.len) return true;
+        std::array<int, 2> pair;
+        for (int j = 0; j < 2; j++) {
+            bool negative = i < text.len && text[i] == '-';
+            if (negative) i++;
+            if (i == text.len || text[i] < '0' || text[i] > '9') return false;
+            int value = 0;
+            while (i < text.len && text[i] >= '0' && text[i] <= '9') {
+                value = value * 10 + (text[i] - '0');
+                i++;
+            }
+            pair[j] = negative ? -value : value;
+            if (j == 0) {
+                if (i == text.len || text[i] != ',') return false;
+                i++;
+            }
+        }
+        pairs.push_back(pair);
+    }
+}
+
+// Solve moves are "cell,direction" turns, "cell,-1" gyros,
+// "-1,direction" rotations, "-2,location" outer and "-3,location" middle gyros
+static bool decodeMove(std::array<int, 2> pair, MoveEntry& entry) {
+    if (pair[0] >= 0) {
+        if (pair[0] > BACK || pair[1] < -1 || pair[1] > XY) return false;
+        entry.cell = (CellLocation)pair[0];
+        if (pair[1] == -1) {
+            entry.type = GYRO;
+        } else {
+            entry.type = TURN;
+            entry.direction = (RotateDirection)pair[1];
+        }
+    } else if (pair[0] == -1) {
+        if (pair[1] < ZY || pair[1] > XY) return false;
+        entry.type = ROTATE;
+        entry.direction = (RotateDirection)pair[1];
+    } else if (pair[0] == -2 || pair[0] == -3) {
+        if (pair[1] < -1 || pair[1] > 1) return false;
+        entry.type = (pair[0] == -2) ? GYRO_OUTER : GYRO_MIDDLE;
+        entry.location = pair[1];
+    } else {
+        return false;
+    }
+    entry.animLength = PuzzleSimulation::getAnimLength(entry);
+    return true;
+}
+
+// Moves only use numbers from -3 to 11
+static inline char* formatNumber(char *out, int value) {
+    if (value < 0) {
+        *out++ = '-';
+        value = -value;
+    }
+    if (value >= 10) *out++ = (char)('0' + value / 10);
+    *out++ = (char)('0' + value % 10);
+    return out;
+}
+
+static inline char* formatPair(char *out, int first, int second) {
+    out = formatNumber(out, first);
+    *out++ = ',';
+    return formatNumber(out, second);
+}
+
+// Same notation as decodeMove, returns the end of what was written
+static char* encodeMove(char *out, const MoveEntry& entry) {
+    switch (entry.type) {
+        case TURN: return formatPair(out, (int)entry.cell, (int)entry.direction);
+        case GYRO: return formatPair(out, (int)entry.cell, -1);
+        case ROTATE: return formatPair(out, -1, (int)entry.direction);
+        case GYRO_OUTER: return formatPair(out, -2, entry.location);
+        case GYRO_MIDDLE: return formatPair(out, -3, entry.location);
+    }
+    return out;
+}
+
+bool PuzzleSimulation::saveLog(std::string filename) {
+    std::ofstream file(filename);
+    if (file.fail()) {
+        return false;
+    }
+    std::string hscScramble = getHscScramble();
+    if (!hscScramble.empty()) {
+        file << "scramble: >\n  " << hscScramble << "\n";
+    }
+    file << "phys_scramble: >\n  " << getPhysScramble() << "\n";
+    file << "phys_solve: >";
+    std::vector<MoveEntry> moves = history->getMoves();
+    char buffer[MAX_FORMATTED_MOVE];
+    for (size_t i = 0; i < moves.size(); i++) {
+        file << ((i % 20 == 0) ? "\n  " : " ");
+        file.write(buffer, encodeMove(buffer, moves[i]) - buffer);
+    }
+    file << "\n";
+    return !file.fail();
+}
+
+bool PuzzleSimulation::loadLog(std::string filename, std::string& error) {
+    std::ifstream file(filename, std::ios::binary);
+    if (file.fail()) {
+        error = "could not open " + filename;
+        return false;
+    }
+    std::vector<char> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    ryml::Tree tree;
+    try {
+        tree = ryml::parse_in_place(ryml::substr(buffer.data(), buffer.size()));
+    } catch (std::runtime_error& e) {
+        error = e.what();
+        return false;
+    }
+    ryml::ConstNodeRef root = tree.crootref();
+    // A stream of documents, as scrambler writes, loads its first one
+    if (root.is_stream() && root.has_children()) root = root.first_child();
+    if (!root.is_map()) {
+        error = "not a log file";
+        return false;
+    }
+
+    reset();
+    std::vector<std::array<int, 2>> pairs;
+    MoveEntry entry;
+    if (root.has_child("phys_scramble") && root["phys_scramble"].has_val()) {
+        if (!parsePairs(root["phys_scramble"].val(), pairs)) {
+            error = "invalid phys_scramble";
+            reset();
+            return false;
+        }
+        // State scrambles are physical moves, which only apply from some configurations
+        for (size_t i = 0; i < pairs.size(); i++) {
+            if (!decodeMove(pairs[i], entry) || (entry.type != GYRO && entry.type != TURN && !MoveTable::canApply(*puzzle, entry))) {
+                error = "invalid scramble move " + std::to_string(i + 1);
+                reset();
+                return false;
+            }
+            applyMove(entry);
+            scramble.push_back(entry);
+        }
+        history->setStart(PackedPuzzle(*puzzle));
+    }
+
+    pairs.clear();
+    if (root.has_child("phys_solve") && root["phys_solve"].has_val()) {
+        if (!parsePairs(root["phys_solve"].val(), pairs)) {
+            error = "invalid phys_solve";
+            reset();
+            return false;
+        }
+        for (size_t i = 0; i < pairs.size(); i++) {
+            if (!decodeMove(pairs[i], entry) || !MoveTable::canApply(*puzzle, entry)) {
+                error = "invalid solve move " + std::to_string(i + 1);
+                reset();
+                return false;
+            }
+            performMove(entry);
+            history->insertMove(entry);
+        }
+    }
+    // Replays once to fill in every checkpoint for seeking
+    seek(history->getMoveCount());
+    return true;
+}
+
+size_t PuzzleSimulation::formatHscScramble(const MoveEntry *moves, size_t count, char *out) {
+    // Cell and direction of the HSC move for each gyro, indexed by CellLocation
+    static const int gyroMoves[8][2] = {
+        {0, 0}, {0, 0},
+        {2, 4}, // RIGHT: U cell turns F
+        {2, 5}, // LEFT: U cell turns B
+        {4, 0}, // UP: F cell turns R
+        {4, 1}, // DOWN: F cell turns L
+        {2, 1}, // FRONT: U cell turns R
+        {2, 0} // BACK: U cell turns L
+    };
+    char *start = out;
+    out = formatPair(out, 0, 0);
+    *out++ = ',';
+    *out++ = '7';
+    *out++ = ' ';
+    for (size_t i = 0; i < count; i++) {
+        if (moves[i].type == GYRO) {
+            out = formatPair(out, gyroMoves[moves[i].cell][0], gyroMoves[moves[i].cell][1]);
+            *out++ = ',';
+            *out++ = '7';
+        } else if (moves[i].type == TURN) {
+            int cell, direction;
+            if (moves[i].cell == IN) {
+                cell = 7;
+            } else if (moves[i].cell == OUT) {
+                cell = 6;
+            } else {
+                cell = (int)moves[i].cell - 2;
+            }
+            direction = (int)moves[i].direction;
+            if (cell >= 2 && cell < 6) direction += 6;
+            out = formatPair(out, cell, direction);
+            *out++ = ',';
+            *out++ = '1';
+        } else {
+            // Physical moves have no HSC equivalent
+            return 0;
+        }
+        *out++ = ' ';
+    }
+    return out - start;
+}
+
+size_t PuzzleSimulation::formatPhysScramble(const MoveEntry *moves, size_t count, char *out) {
+    char *start = out;
+    for (size_t i = 0; i < count; i++) {
+        out = encodeMove(out, moves[i]);
+        *out++ = ' ';
+    }
+    return out - start;
+}
+
+std::string PuzzleSimulation::getHscScramble() {
+    std::string hscScramble(MAX_FORMATTED_SCRAMBLE(scramble.size()), ' ');
+    hscScramble.resize(formatHscScramble(scramble.data(), scramble.size(), &hscScramble[0]));
+    return hscScramble;
+}
+
+std::string PuzzleSimulation::getPhysScramble() {
+    std::string physScramble(MAX_FORMATTED_SCRAMBLE(scramble.size()), ' ');
+    physScramble.resize(formatPhysScramble(scramble.data(), scramble.size(), &physScramble[0]));
+    return physScramble;
+}
@@ -0,0 +1,121 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "move.h"
+#include "history.h"
+#include "puzzle.h"
+
+class Solver;
+
+// Scrambles without gyros count this many moves, gyros are never consecutive
+#define MAX_SCRAMBLE_MOVES(length) (2 * (length))
+// Longest "c,dd,l " HSC or "c,d " physical move, and the leading HSC move
+#define MAX_FORMATTED_MOVE 8
+#define MAX_FORMATTED_SCRAMBLE(moves) (MAX_FORMATTED_MOVE * ((moves) + 1))
+
+// xoshiro256**, much cheaper than mt19937 and its distributions
+class ScrambleRandom {
+    public:
+        ScrambleRandom();
+        void seed(uint64_t seed);
+        uint64_t next();
+        // Uniform in [0, bound), bound below 2^32
+        uint32_t below(uint32_t bound);
+
+    private:
+        uint64_t state[4];
+};
+
+// Slice moves a gyro needs first, then the gyro itself
+typedef struct {
+    int count;
+    MoveEntry moves[3];
+} GyroExpansion;
+
+// Puzzle state, move history and scrambles, independent of any window or renderer
+class PuzzleSimulation {
+    public:
+        PuzzleSimulation();
+        // Borrows puzzle, which must outlive the simulation
+        PuzzleSimulation(Puzzle *puzzle);
+        ~PuzzleSimulation();
+        Puzzle* getPuzzle();
+        MoveHistory* getHistory();
+        void seed(unsigned int seed);
+
+        // Moves needed to make a gyro or turn from the current slice configuration
+        std::vector<MoveEntry> expandGyro(CellLocation cell);
+        // Precomputed for every cell and PackedPuzzle configuration
+        static const GyroExpansion& getGyroExpansion(CellLocation cell, int config);
+        // Every expansion is legal move by move from its configuration, gyros the cell
+        // asked for and ends where the Puzzle's own gyro moves do, through the MoveTable too
+        static bool verifyGyroExpansions();
+        std::vector<MoveEntry> expandCellMove(CellLocation cell, RotateDirection direction);
+        // Expands a GYRO or TURN entry as above, any other move is returned as it is
+        std::vector<MoveEntry> expandMove(MoveEntry entry);
+        void performMove(MoveEntry entry);
+        // Expands and performs immediately, without recording history
+        void applyMove(MoveEntry entry);
+        // As above, then starts a new history from the resulting state
+        void applyMovesImmediate(const MoveEntry *moves, size_t count);
+        void applyMovesImmediate(const std::vector<MoveEntry>& moves);
+        void reset();
+        // Restores the nearest checkpoint and applies the rest, at most
+        // CHECKPOINT_INTERVAL moves when checkpoints are already filled in
+        bool seek(size_t index);
+
+        // Random GYRO and TURN entries, stored as the current scramble
+        const std::vector<MoveEntry>& generateScramble(int scrambleLength);
+        // As above into a buffer of MAX_SCRAMBLE_MOVES entries, returns how many were written
+        size_t generateScramble(int scrambleLength, MoveEntry *moves);
+        // Bounded-depth state scramble: a random walk of depth physical moves without
+        // rotations, then the shortest moves from solved to the same state, which
+        // may be fewer. States beyond depth moves are never reached, so this is not
+        // a uniformly random state. False if the solver gives up
+        bool generateStateScramble(Solver& solver, int depth);
+        const std::vector<MoveEntry>& getScramble();
+        // Applies a list of "cell,direction" pairs, with -1 for gyros
+        bool loadScramble(std::string filename);
+        // Empty when the scramble has moves other than GYRO and TURN
+        std::string getHscScramble();
+        std::string getPhysScramble();
+        // Write at most MAX_FORMATTED_SCRAMBLE(count) characters, without a terminator
+        static size_t formatHscScramble(const MoveEntry *moves, size_t count, char *out);
+        static size_t formatPhysScramble(const MoveEntry *moves, size_t count, char *out);
+
+        // YAML log with the scramble in both notations and the solve moves,
+        // loading applies every move directly without animating
+        bool saveLog(std::string filename);
+        bool loadLog(std::string filename, std::string& error);
+        static float getAnimLength(MoveEntry entry);
+
+    private:
+        Puzzle *puzzle;
+        bool ownsPuzzle;
+        MoveHistory *history;
+        ScrambleRandom rng;
+        std::vector<MoveEntry> scramble;
+};
+
+#endif // simulation.h
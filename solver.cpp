@@ -0,0 +1,603 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+#include "solver.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <set>
+#include <thread>
+
+#define TABLE_SIZE (STICKER_COUNT * 16 * CONFIG_COUNT)
+#define UNREACHED 0xFF
+
+static std::vector<PackedPuzzle> findSolvedStates() {
+    // The orientations Puzzle::isSolved accepts, packed for sticker lookups
+    const std::vector<Puzzle>& orientations = Puzzle::solvedOrientations();
+    return std::vector<PackedPuzzle>(orientations.begin(), orientations.end());
+}
+
+const std::vector<PackedPuzzle>& Solver::solvedStates() {
+    static const std::vector<PackedPuzzle> states = findSolvedStates();
+    return states;
+}
+
+Solver::Solver() : layout(PieceLayout::get()) {
+    threads = 0;
+    rotations = true;
+    nodeLimit = SOLVER_NODE_LIMIT;
+    nodeCount = 0;
+    hintProgress = 0;
+    hintPieces = 0;
+    hintKept = HINT_KEPT_ALL;
+    std::mt19937_64 rng(0x3704);
+    stickerKeys.resize(SOLVER_MAX_PIECES * TRACKED_STICKERS * STICKER_COUNT);
+    for (size_t i = 0; i < stickerKeys.size(); i++) stickerKeys[i] = rng();
+    for (int i = 0; i < CONFIG_COUNT; i++) configKeys[i] = rng();
+    for (int i = 0; i <= MOVE_COUNT; i++) lastKeys[i] = rng();
+    ttStamp = 0;
+    const MoveTable& table = MoveTable::get();
+    std::map<const uint8_t*, uint8_t> shared;
+    for (int move = 0; move < MOVE_COUNT; move++) {
+        for (int config = 0; config < CONFIG_COUNT; config++) {
+            const uint8_t *permutation = table.getPermutation(move, config);
+            if (!shared.count(permutation)) {
+                std::array<uint8_t, STICKER_COUNT> inverse;
+                for (int i = 0; i < STICKER_COUNT; i++) {
+                    inverse[permutation[i]] = (uint8_t)i;
+                }
+                shared[permutation] = (uint8_t)inverses.size();
+                inverses.push_back(inverse);
+            }
+            inverseIndex[move][config] = shared[permutation];
+        }
+    }
+
+    // A move undoing another from every configuration it can be made from
+    for (int move = 0; move < MOVE_COUNT; move++) {
+        oppositeMove[move] = -1;
+        for (int other = 0; other < MOVE_COUNT && oppositeMove[move] == -1; other++) {
+            bool undoes = true;
+            for (int config = 0; config < CONFIG_COUNT && undoes; config++) {
+                int next = table.getNextConfig(move, config);
+                if (next == ILLEGAL_CONFIG) continue;
+                undoes = table.getNextConfig(other, next) == config &&
+                    std::memcmp(table.getPermutation(other, next), inverses[inverseIndex[move][config]].data(), STICKER_COUNT) == 0;
+            }
+            if (undoes) oppositeMove[move] = (int8_t)other;
+        }
+    }
+}
+
+bool Solver::loadPatterns(const std::string& filename) {
+    return patterns.open(filename);
+}
+
+void Solver::setThreads(int threads) {
+    this->threads = threads;
+}
+
+void Solver::setRotations(bool rotations) {
+    this->rotations = rotations;
+}
+
+void Solver::setNodeLimit(uint64_t limit) {
+    nodeLimit = limit;
+}
+
+int Solver::getHintProgress() {
+    return hintProgress;
+}
+
+int Solver::getHintPieces() {
+    return hintPieces;
+}
+
+HintKept Solver::getHintKept() {
+    return hintKept;
+}
+
+uint64_t Solver::getNodeCount() {
+    return nodeCount;
+}
+
+bool Solver::locatePiece(const PackedPuzzle& state, const PackedPuzzle& goal, int piece,
+                         std::vector<bool>& claimed, uint8_t *positions) {
+    // Pieces are told apart by their colours, which are unique in every piece
+    std::multiset<int> colors;
+    for (int i = 0; i < layout.pieceSize[piece]; i++) {
+        colors.insert(goal.getSticker(layout.pieceStart[piece] + i));
+    }
+    for (size_t other = 0; other < layout.pieceSize.size(); other++) {
+        if (claimed[other] || layout.pieceSize[other] != layout.pieceSize[piece]) continue;
+        std::multiset<int> otherColors;
+        for (int i = 0; i < layout.pieceSize[other]; i++) {
+            otherColors.insert(state.getSticker(layout.pieceStart[other] + i));
+        }
+        if (otherColors != colors) continue;
+        claimed[other] = true;
+        int count = std::min(layout.pieceSize[piece], TRACKED_STICKERS);
+        for (int i = 0; i < TRACKED_STICKERS; i++) {
+            positions[i] = 0;
+            if (i >= count) continue;
+            Color color = goal.getSticker(layout.pieceStart[piece] + i);
+            for (int j = 0; j < layout.pieceSize[other]; j++) {
+                if (state.getSticker(layout.pieceStart[other] + j) == color) {
+                    positions[i] = (uint8_t)(layout.pieceStart[other] + j);
+                }
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+int Solver::tableIndex(const uint8_t *positions, int config) const {
+    // Later stickers share the first one's piece, so only their offset is needed
+    int size = layout.pieceSize[layout.slotPiece[positions[0]]];
+    int second = (size > 1) ? layout.slotOffset[positions[1]] : 0;
+    int third = (size > 2) ? layout.slotOffset[positions[2]] : 0;
+    return ((positions[0] * 4 + second) * 4 + third) * CONFIG_COUNT + config;
+}
+
+const std::vector<uint8_t>& Solver::getTable(const TrackedPiece& piece) {
+    uint32_t key = piece.home[0] | (piece.home[1] << 8) | (piece.home[2] << 16);
+    std::map<uint32_t, std::vector<uint8_t>>::iterator found = tables.find(key);
+    if (found != tables.end()) {
+        return found->second;
+    }
+
+    // Breadth-first search backwards from home in every configuration
+    const MoveTable& table = MoveTable::get();
+    std::vector<uint8_t>& distances = tables[key];
+    distances.assign(TABLE_SIZE, UNREACHED);
+    std::vector<std::pair<std::array<uint8_t, TRACKED_STICKERS>, int>> frontier, next;
+    std::array<uint8_t, TRACKED_STICKERS> home;
+    std::copy(piece.home, piece.home + TRACKED_STICKERS, home.begin());
+    for (int config = 0; config < CONFIG_COUNT; config++) {
+        distances[tableIndex(home.data(), config)] = 0;
+        frontier.push_back(std::make_pair(home, config));
+    }
+    // Moves and the configurations they start from, by the configuration they end in
+    std::vector<std::pair<int, int>> predecessors[CONFIG_COUNT];
+    for (int move = 0; move < MOVE_COUNT; move++) {
+        for (int config = 0; config < CONFIG_COUNT; config++) {
+            int reached = table.getNextConfig(move, config);
+            if (reached != ILLEGAL_CONFIG) predecessors[reached].push_back(std::make_pair(move, config));
+        }
+    }
+    for (int depth = 1; frontier.size(); depth++) {
+        next.clear();
+        for (size_t i = 0; i < frontier.size(); i++) {
+            const std::vector<std::pair<int, int>>& moves = predecessors[frontier[i].second];
+            for (size_t k = 0; k < moves.size(); k++) {
+                int config = moves[k].second;
+                // The sticker now at slot p was at permutation[p] before the move
+                const uint8_t *permutation = table.getPermutation(moves[k].first, config);
+                std::array<uint8_t, TRACKED_STICKERS> before;
+                for (int j = 0; j < TRACKED_STICKERS; j++) {
+                    before[j] = (j < piece.count) ? permutation[frontier[i].first[j]] : 0;
+                }
+                uint8_t& distance = distances[tableIndex(before.data(), config)];
+                if (distance == UNREACHED) {
+                    distance = (uint8_t)depth;
+                    next.push_back(std::make_pair(before, config));
+                }
+            }
+        }
+        frontier.swap(next);
+    }
+    return distances;
+}
+
+// A loaded pattern database whose pieces are all being tracked
+typedef struct {
+    const uint8_t *data;
+    PatternIndexer indexer;
+    std::vector<int> tracked;
+} PatternGroup;
+
+// One search over a fixed set of pieces, shared by every thread
+class SolverSearch {
+    public:
+        SolverSearch(Solver& solver, const std::vector<TrackedPiece>& pieces) : solver(solver), table(MoveTable::get()) {
+            trackedCount = (int)pieces.size();
+            goalConfig = -1;
+            nodeLimit = solver.nodeLimit;
+            for (int move = 0; move < MOVE_COUNT; move++) {
+                allowed[move] = solver.rotations || table.moveEntry(move).type != ROTATE;
+            }
+            for (size_t i = 0; i < pieces.size(); i++) {
+                tables.push_back(solver.getTable(pieces[i]).data());
+            }
+            for (size_t i = 0; i < solver.patterns.getTableCount(); i++) {
+                const PatternTableHeader& header = solver.patterns.getHeader(i);
+                std::vector<TrackedPiece> grouped;
+                std::vector<int> tracked;
+                for (uint32_t j = 0; j < header.pieceCount; j++) {
+                    TrackedPiece piece;
+                    piece.count = header.counts[j];
+                    std::copy(header.home[j], header.home[j] + TRACKED_STICKERS, piece.home);
+                    grouped.push_back(piece);
+                    for (size_t k = 0; k < pieces.size(); k++) {
+                        if (pieces[k].home[0] == piece.home[0]) tracked.push_back((int)k);
+                    }
+                }
+                if (tracked.size() == grouped.size()) {
+                    PatternGroup group = {solver.patterns.getData(i), PatternIndexer(grouped), tracked};
+                    groups.push_back(group);
+                }
+            }
+        }
+
+        int heuristic(const SearchState& state) const {
+            int best = 0;
+            for (int i = 0; i < trackedCount; i++) {
+                int distance = tables[i][solver.tableIndex(&state.positions[i * TRACKED_STICKERS], state.config)];
+                best = std::max(best, distance);
+            }
+            for (size_t i = 0; i < groups.size(); i++) {
+                best = std::max(best, groupDistance(groups[i], state.positions, state.config));
+            }
+            return best;
+        }
+
+        int groupDistance(const PatternGroup& group, const uint8_t *positions, int config) const {
+            uint8_t grouped[PATTERN_MAX_PIECES * TRACKED_STICKERS];
+            for (size_t i = 0; i < group.tracked.size(); i++) {
+                std::copy(&positions[group.tracked[i] * TRACKED_STICKERS], &positions[(group.tracked[i] + 1) * TRACKED_STICKERS],
+                          &grouped[i * TRACKED_STICKERS]);
+            }
+            return patternDistance(group.data, group.indexer.index(grouped, config));
+        }
+
+        uint64_t hash(const SearchState& state, int last) const {
+            uint64_t hash = stamp ^ solver.configKeys[state.config] ^ solver.lastKeys[last + 1];
+            for (int i = 0; i < trackedCount * TRACKED_STICKERS; i++) {
+                hash ^= solver.stickerKeys[i * STICKER_COUNT + state.positions[i]];
+            }
+            return hash;
+        }
+
+        // Estimate after the move, or -1 as soon as a piece is further than limit
+        int applyWithin(const SearchState& state, int move, int limit, SearchState& next) const {
+            int config = table.getNextConfig(move, state.config);
+            if (config == ILLEGAL_CONFIG) return -1;
+            const uint8_t *inverse = solver.inverses[solver.inverseIndex[move][state.config]].data();
+            int best = 0;
+            for (int i = 0; i < trackedCount; i++) {
+                uint8_t *positions = &next.positions[i * TRACKED_STICKERS];
+                for (int j = 0; j < TRACKED_STICKERS; j++) {
+                    positions[j] = inverse[state.positions[i * TRACKED_STICKERS + j]];
+                }
+                int distance = tables[i][solver.tableIndex(positions, config)];
+                if (distance > limit) return -1;
+                best = std::max(best, distance);
+            }
+            for (size_t i = 0; i < groups.size(); i++) {
+                int distance = groupDistance(groups[i], next.positions, config);
+                if (distance > limit) return -1;
+                best = std::max(best, distance);
+            }
+            next.config = (uint8_t)config;
+            return best;
+        }
+
+        bool reached(const SearchState& state, int estimate) const {
+            return estimate == 0 && (goalConfig == -1 || state.config == goalConfig);
+        }
+
+        // Skips undoing the last move, and orders moves that commute with it
+        bool redundant(int move, int last) const {
+            if (last < 0) return false;
+            if (move == solver.oppositeMove[last]) return true;
+            if (move == last && table.getOrder(move) == 2) return true;
+            return move < last && table.commutes(move, last);
+        }
+
+        int trackedCount;
+        // Any configuration when -1
+        int goalConfig;
+        bool allowed[MOVE_COUNT];
+        std::vector<const uint8_t*> tables;
+        std::vector<PatternGroup> groups;
+        Solver& solver;
+        const MoveTable& table;
+        // Mixed into every hash, new for each iteration
+        uint64_t stamp;
+
+        // Written by the workers of one iteration
+        std::atomic<size_t> nextRoot;
+        std::atomic<int> bestRoot;
+        std::atomic<uint64_t> nodes;
+        uint64_t nodeLimit;
+        std::mutex solutionMutex;
+        std::vector<int> solution;
+};
+
+// Depth-first search of one root move, with its own transposition table
+class SolverWorker {
+    public:
+        SolverWorker(SolverSearch& search, std::vector<uint64_t>& keys, std::vector<uint8_t>& depths)
+            : search(search), keys(keys), depths(depths) {}
+
+        void run(const SearchState& start, const std::vector<int>& roots, int bound) {
+            pending = 0;
+            size_t root;
+            while ((root = search.nextRoot++) < roots.size()) {
+                if ((int)root > search.bestRoot || search.nodes > search.nodeLimit) break;
+                this->root = (int)root;
+                SearchState next;
+                int estimate = search.applyWithin(start, roots[root], bound - 1, next);
+                if (estimate < 0) continue;
+                path.assign(1, roots[root]);
+                if (visit(next, 1, estimate, bound, roots[root])) {
+                    std::lock_guard<std::mutex> lock(search.solutionMutex);
+                    if ((int)root < search.bestRoot) {
+                        search.bestRoot = (int)root;
+                        search.solution = path;
+                    }
+                }
+            }
+            search.nodes += pending;
+        }
+
+    private:
+        SolverSearch& search;
+        std::vector<uint64_t>& keys;
+        std::vector<uint8_t>& depths;
+        std::vector<int> path;
+        uint64_t pending;
+        int root;
+
+        // Stays stopped once over the limit, so the remaining siblings unwind too
+        bool stopped() {
+            if (++pending >= 4096) {
+                search.nodes += pending;
+                pending = 0;
+            }
+            return search.nodes > search.nodeLimit;
+        }
+
+        bool visit(const SearchState& state, int depth, int estimate, int bound, int last) {
+            if (search.reached(state, estimate)) return true;
+            if (stopped() || search.bestRoot < root) return false;
+            // Already searched from here with at least as many moves left
+            uint64_t key = search.hash(state, last);
+            size_t slot = key & ((1 << SOLVER_TT_BITS) - 1);
+            if (keys[slot] == key && depths[slot] <= depth) return false;
+            keys[slot] = key;
+            depths[slot] = (uint8_t)depth;
+
+            SearchState next;
+            for (int move = 0; move < MOVE_COUNT; move++) {
+                if (!search.allowed[move] || search.redundant(move, last)) continue;
+                int nextEstimate = search.applyWithin(state, move, bound - depth - 1, next);
+                if (nextEstimate < 0) continue;
+                path.push_back(move);
+                if (visit(next, depth + 1, nextEstimate, bound, move)) return true;
+                path.pop_back();
+            }
+            return false;
+        }
+};
+
+bool Solver::solve(const PackedPuzzle& start, const PackedPuzzle& goal, const std::vector<int>& pieces,
+                   int maxDepth, std::vector<MoveEntry>& solution, bool matchConfig) {
+    solution.clear();
+    nodeCount = 0;
+    if (pieces.size() > SOLVER_MAX_PIECES) return false;
+    std::vector<TrackedPiece> tracked;
+    SearchState state;
+    std::memset(&state, 0, sizeof(state));
+    state.config = (uint8_t)start.getConfig();
+    std::vector<bool> claimed(layout.pieceSize.size(), false);
+    for (size_t i = 0; i < pieces.size(); i++) {
+        tracked.push_back(layout.trackPiece(pieces[i]));
+        if (!locatePiece(start, goal, pieces[i], claimed, &state.positions[i * TRACKED_STICKERS])) {
+            return false;
+        }
+    }
+
+    SolverSearch* search = new SolverSearch(*this, tracked);
+    search->goalConfig = matchConfig ? goal.getConfig() : -1;
+    int estimate = search->heuristic(state);
+    if (search->reached(state, estimate)) {
+        delete search;
+        return true;
+    }
+    std::vector<int> roots;
+    for (int move = 0; move < MOVE_COUNT; move++) {
+        if (search->allowed[move] && search->table.getNextConfig(move, state.config) != ILLEGAL_CONFIG) roots.push_back(move);
+    }
+    int threadCount = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+#ifdef __EMSCRIPTEN__
+    threadCount = 1;
+#endif
+    while ((int)ttKeys.size() < threadCount) {
+        ttKeys.push_back(std::vector<uint64_t>(1 << SOLVER_TT_BITS, 0));
+        ttDepths.push_back(std::vector<uint8_t>(1 << SOLVER_TT_BITS, 0));
+    }
+    std::vector<SolverWorker*> workers;
+    for (int i = 0; i < threadCount; i++) {
+        workers.push_back(new SolverWorker(*search, ttKeys[i], ttDepths[i]));
+    }
+
+    search->nodes = 0;
+    bool found = false;
+    for (int bound = std::max(estimate, 1); bound <= maxDepth && !found; bound++) {
+        search->nextRoot = 0;
+        search->bestRoot = INT_MAX;
+        // Entries of earlier iterations, and earlier searches, no longer match
+        search->stamp = ++ttStamp * 0x9e3779b97f4a7c15ULL;
+        std::vector<std::thread> running;
+        for (int i = 1; i < threadCount; i++) {
+            running.push_back(std::thread(&SolverWorker::run, workers[i], std::cref(state), std::cref(roots), bound));
+        }
+        workers[0]->run(state, roots, bound);
+        for (size_t i = 0; i < running.size(); i++) {
+            running[i].join();
+        }
+        found = search->bestRoot != INT_MAX;
+        if (search->nodes > search->nodeLimit) break;
+    }
+    nodeCount = search->nodes;
+
+    if (found) {
+        // Outer gyros are recorded by the side the outer slice moves from
+        const MoveTable& table = MoveTable::get();
+        int config = state.config;
+        for (size_t i = 0; i < search->solution.size(); i++) {
+            MoveEntry entry = table.moveEntry(search->solution[i]);
+            if (entry.type == GYRO_OUTER) {
+                int outerSlicePos, middleSlicePos;
+                CellLocation middleSliceDir;
+                PackedPuzzle::decodeConfig(config, outerSlicePos, middleSlicePos, middleSliceDir);
+                entry.location = -outerSlicePos;
+            }
+            solution.push_back(entry);
+            config = table.getNextConfig(search->solution[i], config);
+        }
+    }
+    for (size_t i = 0; i < workers.size(); i++) {
+        delete workers[i];
+    }
+    delete search;
+    return found;
+}
+
+bool Solver::findHint(const Puzzle& puzzle, int maxDepth, std::vector<MoveEntry>& solution) {
+    solution.clear();
+    PackedPuzzle state(puzzle);
+    const std::vector<PackedPuzzle>& goals = solvedStates();
+
+    // Orientation with the most pieces in finished cells, then its most complete
+    // unfinished cell. Every hint raises one of those, so hints never go in circles
+    int bestGoal = -1, bestSolved = -1, bestFinished = -1;
+    std::vector<int> bestPieces;
+    std::vector<bool> bestKept;
+    for (size_t goal = 0; goal < goals.size(); goal++) {
+        std::array<std::vector<int>, 8> cellPieces, cellSolved;
+        int total = 0;
+        for (size_t piece = 0; piece < layout.pieceSize.size(); piece++) {
+            bool solved = true;
+            for (int i = 0; i < layout.pieceSize[piece]; i++) {
+                int slot = layout.pieceStart[piece] + i;
+                solved = solved && state.getSticker(slot) == goals[goal].getSticker(slot);
+            }
+            total += solved;
+            for (int i = 0; i < layout.pieceSize[piece]; i++) {
+                int color = goals[goal].getSticker(layout.pieceStart[piece] + i);
+                cellPieces[color].push_back((int)piece);
+                if (solved) cellSolved[color].push_back((int)piece);
+            }
+        }
+        if (total == (int)layout.pieceSize.size()) {
+            hintProgress = hintPieces = 0;
+            hintKept = HINT_KEPT_ALL;
+            return true;
+        }
+        std::vector<bool> finished(layout.pieceSize.size(), false);
+        for (int color = 0; color < 8; color++) {
+            if (cellSolved[color].size() < cellPieces[color].size()) continue;
+            for (size_t i = 0; i < cellPieces[color].size(); i++) {
+                finished[cellPieces[color][i]] = true;
+            }
+        }
+        int finishedCount = (int)std::count(finished.begin(), finished.end(), true);
+        for (int color = 0; color < 8; color++) {
+            int solved = (int)cellSolved[color].size();
+            if (solved == (int)cellPieces[color].size()) continue;
+            if (finishedCount > bestFinished || (finishedCount == bestFinished && solved > bestSolved)) {
+                bestGoal = (int)goal;
+                bestSolved = solved;
+                bestFinished = finishedCount;
+                bestPieces = cellPieces[color];
+                bestKept = finished;
+                for (size_t i = 0; i < cellSolved[color].size(); i++) {
+                    bestKept[cellSolved[color][i]] = true;
+                }
+            }
+        }
+    }
+    if (bestGoal == -1) return false;
+    const PackedPuzzle& goal = goals[bestGoal];
+    hintProgress = bestSolved;
+    hintPieces = (int)bestPieces.size();
+
+    std::vector<int> solved, kept, unsolved;
+    std::vector<bool> inCell(layout.pieceSize.size(), false);
+    for (size_t i = 0; i < bestPieces.size(); i++) {
+        inCell[bestPieces[i]] = true;
+    }
+    for (size_t piece = 0; piece < layout.pieceSize.size(); piece++) {
+        bool home = true;
+        for (int j = 0; j < layout.pieceSize[piece]; j++) {
+            home = home && state.getSticker(layout.pieceStart[piece] + j) == goal.getSticker(layout.pieceStart[piece] + j);
+        }
+        if (home) {
+            solved.push_back((int)piece);
+            if (bestKept[piece]) kept.push_back((int)piece);
+        } else if (inCell[piece]) {
+            unsolved.push_back((int)piece);
+        }
+    }
+    // Closest pieces first, by their distance alone
+    std::vector<std::pair<int, int>> candidates;
+    for (size_t i = 0; i < unsolved.size(); i++) {
+        std::vector<bool> claimed(layout.pieceSize.size(), false);
+        uint8_t positions[TRACKED_STICKERS];
+        if (!locatePiece(state, goal, unsolved[i], claimed, positions)) continue;
+        int distance = getTable(layout.trackPiece(unsolved[i]))[tableIndex(positions, state.getConfig())];
+        candidates.push_back(std::make_pair(distance, unsolved[i]));
+    }
+    if (candidates.empty()) return false;
+    std::sort(candidates.begin(), candidates.end());
+
+    // A few of the closest pieces keeping every solved piece, then keeping only
+    // the finished cells and the cell's solved pieces
+    std::vector<std::pair<std::vector<int>, HintKept>> attempts;
+    for (int level = HINT_KEPT_ALL; level <= HINT_KEPT_NONE; level++) {
+        // Nothing to gain from the second when every solved piece is kept anyway
+        if (level == HINT_KEPT_CELL && kept.size() == solved.size()) continue;
+        for (size_t i = 0; i < candidates.size() && i < HINT_CANDIDATES; i++) {
+            if (level == HINT_KEPT_NONE && hinted.count(std::make_pair(puzzle.getHash(), candidates[i].second))) continue;
+            attempts.push_back(std::make_pair((level == HINT_KEPT_ALL) ? solved : (level == HINT_KEPT_CELL) ? kept : std::vector<int>(), (HintKept)level));
+            attempts.back().first.push_back(candidates[i].second);
+        }
+    }
+    if (attempts.empty()) return false;
+
+    // The node limit is shared by every attempt
+    uint64_t limit = nodeLimit, total = 0;
+    nodeLimit = std::max<uint64_t>(limit / attempts.size(), 1);
+    bool found = false;
+    for (size_t i = 0; i < attempts.size() && !found; i++) {
+        found = solve(state, goal, attempts[i].first, maxDepth, solution);
+        hintKept = attempts[i].second;
+        total += nodeCount;
+        if (found && hintKept == HINT_KEPT_NONE) hinted.insert(std::make_pair(puzzle.getHash(), attempts[i].first.back()));
+    }
+    nodeLimit = limit;
+    nodeCount = total;
+    if (!found) solution.clear();
+    return found;
+}
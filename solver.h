@@ -0,0 +1,124 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <array>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "move.h"
+#include "movetable.h"
+#include "packed.h"
+#include "patterns.h"
+
+#define SOLVER_MAX_PIECES 80
+#define SOLVER_TT_BITS 18
+#define SOLVER_NODE_LIMIT 100000000ULL
+#define HINT_DEPTH 8
+// Shared by the 3 * HINT_CANDIDATES searches a hint makes at most
+#define HINT_NODE_LIMIT 2000000ULL
+#define HINT_CANDIDATES 3
+
+typedef enum : int {
+    // Every solved piece stays solved
+    HINT_KEPT_ALL,
+    // Only finished cells and the hinted cell's solved pieces stay solved
+    HINT_KEPT_CELL,
+    // Only the new piece is solved, others may be broken up
+    HINT_KEPT_NONE
+} HintKept;
+
+typedef struct {
+    // Tracked pieces in order, TRACKED_STICKERS slots each
+    uint8_t positions[SOLVER_MAX_PIECES * TRACKED_STICKERS];
+    uint8_t config;
+} SearchState;
+
+// Iterative-deepening A* over the physical moves of MoveTable, on the
+// positions of a few tracked pieces. The heuristic is the largest exact
+// distance of any single piece, from a breadth-first pattern database per piece,
+// or of a group of pieces when a pattern file covering them is loaded.
+class Solver {
+    public:
+        Solver();
+        // Maps pattern databases written by pdbgen, false if the file is missing or stale
+        bool loadPatterns(const std::string& filename);
+        // Root moves are shared between this many threads, 0 for one per core
+        void setThreads(int threads);
+        // Whether solutions may rotate the whole puzzle, they may by default
+        void setRotations(bool rotations);
+        // Gives up on a search after visiting this many positions
+        void setNodeLimit(uint64_t limit);
+        // Shortest moves bringing every piece home from start, false if longer than maxDepth.
+        // With matchConfig the slices must also end in the goal configuration
+        bool solve(const PackedPuzzle& start, const PackedPuzzle& goal, const std::vector<int>& pieces,
+                   int maxDepth, std::vector<MoveEntry>& solution, bool matchConfig = false);
+        // Solves one cell at a time, one piece at a time, keeping every solved piece.
+        // When that runs out of depth or nodes it keeps only the finished cells and the
+        // cell's solved pieces, then none, never hinting a piece twice from one position.
+        // The node limit covers every search together.
+        // Returns the moves for the next piece, empty if the puzzle is solved
+        bool findHint(const Puzzle& puzzle, int maxDepth, std::vector<MoveEntry>& solution);
+        // Pieces of the hinted cell that were solved before the hint, and its size
+        int getHintProgress();
+        int getHintPieces();
+        // Which solved pieces the last hint keeps
+        HintKept getHintKept();
+        uint64_t getNodeCount();
+
+        // Every orientation of the solved puzzle
+        static const std::vector<PackedPuzzle>& solvedStates();
+
+    private:
+        int threads;
+        bool rotations;
+        uint64_t nodeLimit;
+        uint64_t nodeCount;
+        int hintProgress, hintPieces;
+        HintKept hintKept;
+        // Positions and pieces of past hints that broke up solved pieces, never repeated
+        std::set<std::pair<uint64_t, int>> hinted;
+        const PieceLayout& layout;
+        PatternFile patterns;
+        // Sticker slot each sticker comes from, inverse of the MoveTable permutations
+        std::vector<std::array<uint8_t, STICKER_COUNT>> inverses;
+        uint8_t inverseIndex[MOVE_COUNT][CONFIG_COUNT];
+        int8_t oppositeMove[MOVE_COUNT];
+        // Distances for each piece home, keyed by its home stickers
+        std::map<uint32_t, std::vector<uint8_t>> tables;
+        // Zobrist keys of the search states, made once
+        std::vector<uint64_t> stickerKeys;
+        uint64_t configKeys[CONFIG_COUNT];
+        uint64_t lastKeys[MOVE_COUNT + 1];
+        // Transposition table of each search thread, kept from one search to the next
+        std::vector<std::vector<uint64_t>> ttKeys;
+        std::vector<std::vector<uint8_t>> ttDepths;
+        uint64_t ttStamp;
+
+        bool locatePiece(const PackedPuzzle& state, const PackedPuzzle& goal, int piece,
+                         std::vector<bool>& claimed, uint8_t *positions);
+        int tableIndex(const uint8_t *positions, int config) const;
+        const std::vector<uint8_t>& getTable(const TrackedPiece& piece);
+        friend class SolverSearch;
+};
+
+#endif // solver.h
@@ -0,0 +1,76 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+#include "sync.h"
+
+InputQueue::InputQueue() : head(0), tail(0) {}
+
+bool InputQueue::push(const InputEvent& event) {
+    size_t current = tail.load(std::memory_order_relaxed);
+    if (current - head.load(std::memory_order_acquire) == INPUT_QUEUE_SIZE) return false;
+    events[current & (INPUT_QUEUE_SIZE - 1)] = event;
+    // The event is written before the consumer can see it
+    tail.store(current + 1, std::memory_order_release);
+    return true;
+}
+
+bool InputQueue::pop(InputEvent& event) {
+    size_t current = head.load(std::memory_order_relaxed);
+    if (current == tail.load(std::memory_order_acquire)) return false;
+    event = events[current & (INPUT_QUEUE_SIZE - 1)];
+    // The slot is read before the producer can reuse it
+    head.store(current + 1, std::memory_order_release);
+    return true;
+}
+
+PuzzleSnapshot::PuzzleSnapshot() {
+    stateVersion = 0;
+    changes = 0;
+    animating = false;
+    for (int i = 0; i < MAX_ANIMATION_GROUP; i++) {
+        moves[i] = MoveEntry();
+    }
+    moveCount = 0;
+    progress = 0.0f;
+    moveSerial = 0;
+    timerRunning = false;
+    sequence = 0;
+}
+
+SnapshotBuffer::SnapshotBuffer() {
+    front = 0;
+    sequence = 0;
+}
+
+PuzzleSnapshot& SnapshotBuffer::back() {
+    // The writer is the only one that swaps, so front is stable here
+    return snapshots[1 - front];
+}
+
+void SnapshotBuffer::publish() {
+    std::lock_guard<std::mutex> lock(swapMutex);
+    snapshots[1 - front].sequence = ++sequence;
+    front = 1 - front;
+}
+
+bool SnapshotBuffer::read(PuzzleSnapshot& frame) {
+    std::lock_guard<std::mutex> lock(swapMutex);
+    if (snapshots[front].sequence == frame.sequence) return false;
+    frame = snapshots[front];
+    return true;
+}
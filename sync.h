@@ -0,0 +1,94 @@
+/**************************************************************************
+ * 3to4++ - https://github.com/rayzchen/3to4++
+ *-------------------------------------------------------------------------
+ * Copyright 2024 Ray Chen
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ **************************************************************************/
+
+#ifndef SYNC_H
+#define SYNC_H
+
+#include <atomic>
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+#include "puzzle.h"
+#include "move.h"
+#include "animation.h"
+
+// Must be a power of two
+#define INPUT_QUEUE_SIZE 64
+
+// A key press without modifiers, with the cell keys held down when it happened
+struct InputEvent {
+    int key;
+    bool flip;
+    // Bit i is set if PuzzleController::cellKeys[i] was down
+    unsigned int heldCells;
+};
+
+// Key presses from the main thread to the simulation thread. Only one thread
+// may push and only one may pop, neither takes a lock
+class InputQueue {
+    public:
+        InputQueue();
+        // False if the queue is full, the press is dropped
+        bool push(const InputEvent& event);
+        bool pop(InputEvent& event);
+
+    private:
+        InputEvent events[INPUT_QUEUE_SIZE];
+        std::atomic<size_t> head;
+        std::atomic<size_t> tail;
+};
+
+// Everything the main thread draws, copied out of the simulation after each step
+struct PuzzleSnapshot {
+    PuzzleSnapshot();
+    Puzzle puzzle;
+    // Bumped whenever the puzzle changes, the scene is rebuilt from it
+    uint64_t stateVersion;
+    // Bumped by any change worth a redraw, including the status text
+    uint64_t changes;
+    bool animating;
+    // Animating together, see MoveAnimator
+    MoveEntry moves[MAX_ANIMATION_GROUP];
+    int moveCount;
+    float progress;
+    uint64_t moveSerial;
+    bool timerRunning;
+    // Set by SnapshotBuffer::publish
+    uint64_t sequence;
+};
+
+// The writer fills the back snapshot while the reader copies the front one,
+// only swapping them and copying out take the lock
+class SnapshotBuffer {
+    public:
+        SnapshotBuffer();
+        // Only the writer may use it, until the next publish
+        PuzzleSnapshot& back();
+        void publish();
+        // Copies the front snapshot into frame if it is newer, true if it was
+        bool read(PuzzleSnapshot& frame);
+
+    private:
+        PuzzleSnapshot snapshots[2];
+        int front;
+        uint64_t sequence;
+        std::mutex swapMutex;
+};
+
+#endif // sync.h
@@ -1,4 +1,11 @@
-.PHONY: all run addicon build shared clean realclean
+.PHONY: all run addicon build shared clean realclean bench lib3to4core patterns
+
+# Standalone tools, kept out of the app and web builds
+TOOL_FILES = bench.cpp benchrender.cpp exporter.cpp pdbgen.cpp scrambler.cpp
+# Simulation without GLFW or GL, for tools that don't need a window
+CORE_OBJFILES = animation.o batch.o history.o movetable.o packed.o patterns.o puzzle.o simulation.o solver.o sync.o
+# Enough of the app to draw the puzzle without a Window
+RENDER_OBJFILES = camera.o control.o pieces.o profiler.o render.o shaders.o gl.o
 
 IMGUI_SOURCEFILES = imgui/imgui.cpp \
 					imgui/imgui_draw.cpp \
@@ -78,6 +85,38 @@ else
 	cp lib/*.so 3to4pp
 endif
 
+lib3to4core:	lib3to4core.a
+
+lib3to4core.a:	$(CORE_OBJFILES)
+	rm -f $@
+	$(AR) rcs $@ $^
+
+bench:	bench.o benchrender.o lib3to4core.a $(RENDER_OBJFILES)
+	$(CXX) $(CXXFLAGS) $(CPPFLAGS) -o bench bench.o -L. -l3to4core
+	$(CXX) $(CXXFLAGS) $(CPPFLAGS) -o benchrender benchrender.o $(RENDER_OBJFILES) -L. -l3to4core $(CCLIBFLAGS)
+	./bench
+	./benchrender
+
+clean: OBJFILES += bench.o benchrender.o lib3to4core.a
+
+patterns:	patterns.pdb
+
+patterns.pdb:	pdbgen.o lib3to4core.a
+	$(CXX) $(CXXFLAGS) $(CPPFLAGS) -o pdbgen pdbgen.o -L. -l3to4core
+	./pdbgen $@
+
+clean: OBJFILES += pdbgen.o
+
+scrambler:	scrambler.o lib3to4core.a
+	$(CXX) $(CXXFLAGS) $(CPPFLAGS) -o scrambler scrambler.o -L. -l3to4core
+
+clean: OBJFILES += scrambler.o
+
+exporter:	exporter.o lib3to4core.a $(RENDER_OBJFILES)
+	$(CXX) $(CXXFLAGS) $(CPPFLAGS) -o exporter exporter.o $(RENDER_OBJFILES) -L. -l3to4core $(CCLIBFLAGS)
+
+clean: OBJFILES += exporter.o
+
 release:
 	rm -rf dist
 	make build
@@ -85,8 +124,9 @@ release:
 	make shared
 	7z a dist/3to4++dll.zip 3to4pp/
 
-emscripten:
+# The model shaders need WebGL 2 for uniform buffers
+emscripten emscripten-small:
 	rm -rf web/3to4++*
-	em++ $(CPPFLAGS) $(CPP_FILES) $(C_FILES) $(IMGUI_SOURCEFILES) \
-		-o web/3to4++.js -sMAX_WEBGL_VERSION=3 -sFILESYSTEM=0 \
+	em++ $(CPPFLAGS) $(filter-out $(TOOL_FILES),$(CPP_FILES)) $(C_FILES) $(IMGUI_SOURCEFILES) \
+		-o web/3to4++.js -sMIN_WEBGL_VERSION=2 -sMAX_WEBGL_VERSION=3 -sFILESYSTEM=0 \
 		-flto --closure 1 -sENVIRONMENT=web
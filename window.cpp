@@ -23,6 +23,8 @@
 #include <stdlib.h>
 #include <linmath.h>
 #include <iostream>
+#include <mutex>
+#include <cmath>
 #include "window.h"
 #include "render.h"
 #include "control.h"
@@ -31,6 +33,9 @@
 #include "gui.h"
 #include "shaders.h"
 #include "constants.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "quality.h"
 #ifdef _WIN32
 #define GLFW_EXPOSE_NATIVE_WIN32
 #include <GLFW/glfw3native.h>
@@ -43,6 +48,8 @@
 
 #define WIDTH 960
 #define HEIGHT 540
+// Pixels the cursor may move between press and release to count as a click
+#define CLICK_DISTANCE 4.0
 
 Window* Window::current;
 
@@ -53,7 +60,8 @@ Window::Window() {
         exit(EXIT_FAILURE);
     }
 
-    glfwWindowHint(GLFW_SAMPLES, 9);
+    // Multisampling happens offscreen, see RenderQuality
+    glfwWindowHint(GLFW_SAMPLES, 0);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -87,17 +95,17 @@ Window::Window() {
     modelShader = new Shader(Shaders::modelVertex, Shaders::modelFragment);
     camera = new Camera(M_PI_4, WIDTH, HEIGHT, 0.02, 50);
     puzzle = new Puzzle();
-    renderer = new PuzzleRenderer(puzzle);
-    controller = new PuzzleController(renderer);
+    framePuzzle = new Puzzle();
+    renderer = new PuzzleRenderer(framePuzzle);
+    controller = new PuzzleController(puzzle, renderer);
     gui = new GuiRenderer(window, controller, WIDTH, HEIGHT);
-    vsync = true;
+    FrameScheduler::get().attach(window);
+    RenderQuality::get().attach(window);
     fullscreen = false;
-    updateBuffer = 0.2f;
-#ifdef __EMSCRIPTEN__
-    maxFrames = 0;
-#else
-    maxFrames = 60;
-#endif
+    guiHovered = false;
+    clickPending = false;
+    pressX = pressY = 0.0;
+    frameTime = 0.0;
 }
 
 void Window::setCallbacks() {
@@ -105,25 +113,32 @@ void Window::setCallbacks() {
         Window::current->mouseButtonCallback(window, button, action);
     });
     glfwSetCursorPosCallback(window, [](GLFWwindow* window, double xpos, double ypos) {
-        // todo: filter correctly with captureMouse()
-        Window::current->setUpdateBuffer();
+        Window::current->cursorPosCallback(window);
     });
     glfwSetScrollCallback(window, [](GLFWwindow* window, double xoffset, double yoffset) {
         if (Window::current->gui->captureMouse()) {
-            Window::current->setUpdateBuffer();
+            Window::current->requestRedraw();
         } else {
-            if (yoffset != 0) Window::current->setUpdateBuffer();
+            if (yoffset != 0) Window::current->requestRedraw();
             Window::current->camera->scrollCallback(window, xoffset, yoffset);
         }
     });
     glfwSetFramebufferSizeCallback(window, [](GLFWwindow* window, int width, int height) {
         Window::current->camera->framebufferSizeCallback(window, width, height);
         Window::current->gui->framebufferSizeCallback(window, width, height);
+        Window::current->requestRedraw();
         Window::current->draw();
     });
+    glfwSetWindowRefreshCallback(window, [](GLFWwindow* window) {
+        Window::current->requestRedraw();
+    });
+    glfwSetWindowFocusCallback(window, [](GLFWwindow* window, int focused) {
+        Window::current->requestRedraw();
+    });
     glfwSetKeyCallback(window, [](GLFWwindow* window, int key, int scancode, int action, int mods) {
         Window::current->keyCallback(window, key, scancode, action, mods);
         Window::current->gui->keyCallback(window, key, action, mods);
+        Window::current->gui->runActions();
         Window::current->controller->keyCallback(window, key, action, mods, Window::current->camera->inputFlipped());
     });
     glfwSetWindowPosCallback(window, [](GLFWwindow* window, int xpos, int ypos) {
@@ -131,8 +146,31 @@ void Window::setCallbacks() {
     });
 }
 
-void Window::setUpdateBuffer() {
-    updateBuffer = 0.2f;
+void Window::requestRedraw() {
+    FrameScheduler::get().requestRedraw();
+}
+
+void Window::cursorPosCallback(GLFWwindow* window) {
+    // Hover changes in the GUI, including leaving it, and dragging the camera or spacing
+    bool hovered = gui->captureMouse();
+    bool dragging = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS ||
+        glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_MIDDLE) == GLFW_PRESS;
+    if (hovered || guiHovered || dragging) {
+        requestRedraw();
+    }
+    guiHovered = hovered;
+    updateHover();
+}
+
+int Window::updateHover() {
+    int cell = -1;
+    if (!gui->captureMouse()) {
+        vec3 origin, direction;
+        camera->getCursorRay(window, origin, direction);
+        cell = renderer->pickCell(origin, direction);
+    }
+    if (controller->setHoverCell(cell)) requestRedraw();
+    return cell;
 }
 
 #ifdef __EMSCRIPTEN__
@@ -156,14 +194,14 @@ void Window::run() {
     glEnable(GL_POLYGON_OFFSET_FILL);
     glPolygonOffset(1.0, 1.0);
 
-    setUpdateBuffer();
+    requestRedraw();
 
 #ifdef __EMSCRIPTEN__
     onCanvasSizeChanged(EMSCRIPTEN_EVENT_RESIZE, NULL, window);
     emscripten_set_resize_callback(EMSCRIPTEN_EVENT_TARGET_WINDOW, window, false, onCanvasSizeChanged);
-    emscripten_set_main_loop([]() {Window::current->updateFunc(); Window::current->setUpdateBuffer();}, maxFrames, true);
+    // Runs on requestAnimationFrame, frames with nothing to draw return early
+    emscripten_set_main_loop([]() {Window::current->updateFunc();}, 0, true);
 #else
-    glfwSwapInterval(0);
     while (!glfwWindowShouldClose(window)) {
         updateFunc();
     }
@@ -171,51 +209,89 @@ void Window::run() {
 }
 
 void Window::updateFunc() {
-    setUpdateBuffer();
-    glfwPollEvents();
-    if (!(fullscreen || maxFrames == 0)) {
-        while (glfwGetTime() - lastTime < 1.0f / maxFrames) {
-            glfwWaitEventsTimeout(1.0 / maxFrames - (glfwGetTime() - lastTime));
-        }
+    FrameScheduler& scheduler = FrameScheduler::get();
+    FrameProfiler& profiler = FrameProfiler::get();
+    profiler.beginStage(POLL_EVENTS);
+    if (scheduler.waitForFrame(lastTime)) {
+        // Time spent asleep was not a frame, keep animations and inertia smooth
+        lastTime = glfwGetTime() - frameTime;
     }
+    profiler.endStage(POLL_EVENTS);
     double tick = glfwGetTime();
     double dt = tick - lastTime;
     lastTime = tick;
-    if (renderer->updateMouse(window, dt)) setUpdateBuffer();
-    if (camera->updateMouse(window, dt)) setUpdateBuffer();
-    if (controller->updatePuzzle(window, dt)) setUpdateBuffer();
+    frameTime = dt;
+    bool changing = false;
+    profiler.beginStage(UPDATE_MOUSE);
+    changing |= renderer->updateMouse(window, dt);
+    changing |= camera->updateMouse(window, dt);
+    profiler.endStage(UPDATE_MOUSE);
+    profiler.beginStage(UPDATE_PUZZLE);
+#ifdef __EMSCRIPTEN__
+    // No simulation thread in the browser
+    controller->stepSimulation(dt);
+#endif
+    uint64_t changes = frame.changes;
+    if (controller->readSnapshot(frame) && frame.changes != changes) {
+        requestRedraw();
+    }
+    renderer->setFrame(frame);
+    changing |= frame.animating;
+    profiler.endStage(UPDATE_PUZZLE);
+    // The timer shows hundredths, so it is redrawn every frame while running
+    changing |= frame.timerRunning || gui->wantsFrames();
+    scheduler.setAnimating(changing);
 
-    if (updateBuffer > 0.0f) {
+    if (scheduler.isFrameDue()) {
         draw();
-        updateBuffer -= dt;
-    } else {
-        updateBuffer = 0.0f;
-        glfwWaitEvents();
-        lastTime = glfwGetTime() - dt;
+        RenderQuality::get().frameDrawn(frameTime, changing);
     }
 }
 
 void Window::draw() {
+    FrameProfiler& profiler = FrameProfiler::get();
+    profiler.beginFrame();
+    RenderQuality& quality = RenderQuality::get();
+    renderer->setShaderEdges(quality.getSettings().edges == EDGES_SHADER);
     glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    quality.beginScene();
     modelShader->use();
-    modelShader->setMat4("view", *camera->getViewMat());
-    modelShader->setMat4("projection", *camera->getProjection());
+    renderer->setCamera(*camera->getViewMat(), *camera->getProjection());
 
+    profiler.beginStage(RENDER_PUZZLE);
     renderer->renderPuzzle(modelShader);
-    if (controller->checkOutline(window, modelShader, camera->inputFlipped())) {
-        setUpdateBuffer();
-    }
+    profiler.endStage(RENDER_PUZZLE);
+    profiler.beginStage(CHECK_OUTLINE);
+    // The puzzle or camera may have moved under a still cursor
+    updateHover();
+    controller->checkOutline(window, modelShader, camera->inputFlipped());
+    profiler.endStage(CHECK_OUTLINE);
+    profiler.beginStage(RESOLVE_SCENE);
+    quality.endScene();
+    profiler.endStage(RESOLVE_SCENE);
+    profiler.beginStage(RENDER_GUI);
     gui->renderGui();
+    profiler.endStage(RENDER_GUI);
+    profiler.beginStage(SWAP_BUFFERS);
     glfwSwapBuffers(window);
-    glfwPollEvents();
+    profiler.endStage(SWAP_BUFFERS);
+    profiler.endFrame();
+    if (profiler.getFirstFrameTime() < 0.0f) {
+        // glfwGetTime counts from glfwInit, which the window calls first
+        profiler.setFirstFrameTime(1000 * glfwGetTime());
+    }
+    FrameScheduler::get().frameDrawn();
 }
 
 Window::~Window() {
     delete modelShader;
     delete camera;
+    // Stops the simulation thread before the puzzle goes
+    delete controller;
     delete renderer;
     delete puzzle;
+    delete framePuzzle;
+    FrameProfiler::get().setEnabled(false);
     glfwDestroyWindow(window);
     glfwTerminate();
 }
@@ -229,41 +305,51 @@ void Window::keyCallback(GLFWwindow* window, int key, int scancode, int action,
     static int saved_y;
     static int saved_w;
     static int saved_h;
+    // Releases too, cell outlines disappear when their key is let go
+    requestRedraw();
     if (action == GLFW_PRESS) {
-        setUpdateBuffer();
         if ((key == GLFW_KEY_ENTER && mods & GLFW_MOD_ALT) || key == GLFW_KEY_F11) {
             if (fullscreen) {
                 glfwSetWindowMonitor(window, NULL, saved_x, saved_y, saved_w, saved_h, GLFW_DONT_CARE);
-                glfwSwapInterval(0);
             } else {
                 glfwGetWindowPos(window, &saved_x, &saved_y);
                 glfwGetWindowSize(window, &saved_w, &saved_h);
                 GLFWmonitor *monitor = glfwGetPrimaryMonitor();
                 const GLFWvidmode* mode = glfwGetVideoMode(monitor);
                 glfwSetWindowMonitor(window, monitor, 0, 0, mode->width, mode->height, mode->refreshRate);
-                glfwSwapInterval(vsync);
             }
+            FrameScheduler::get().applySyncMode();
             fullscreen = !fullscreen;
         }
     }
 }
 
 void Window::windowPosCallback(GLFWwindow* window, int xpos, int ypos) {
+    requestRedraw();
     Window::current->draw();
 }
 
 void Window::mouseButtonCallback(GLFWwindow* window, int button, int action) {
-    if (gui->captureMouse()) {
-        setUpdateBuffer();
-    } else {
+    requestRedraw();
+    if (!gui->captureMouse()) {
         if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
             camera->setMousePressed(true);
+            clickPending = true;
+            glfwGetCursorPos(window, &pressX, &pressY);
         } else if (button == GLFW_MOUSE_BUTTON_MIDDLE && action == GLFW_PRESS) {
             renderer->setMousePressed(true);
         }
     }
     if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE) {
         camera->setMousePressed(false);
+        if (clickPending) {
+            double x, y;
+            glfwGetCursorPos(window, &x, &y);
+            if (std::hypot(x - pressX, y - pressY) < CLICK_DISTANCE) {
+                controller->clickCell(updateHover());
+            }
+            clickPending = false;
+        }
     } else if (button == GLFW_MOUSE_BUTTON_MIDDLE && action == GLFW_RELEASE) {
         renderer->setMousePressed(false);
     }
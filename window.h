@@ -38,8 +38,11 @@ class Window {
         void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
         void windowPosCallback(GLFWwindow* window, int xpos, int ypos);
         void mouseButtonCallback(GLFWwindow* window, int button, int action);
+        void cursorPosCallback(GLFWwindow* window);
         void setCallbacks();
-        void setUpdateBuffer();
+        void requestRedraw();
+        // Picks the cell under the cursor for the hover outline
+        int updateHover();
 
     private:
         GLFWwindow *window;
@@ -48,12 +51,17 @@ class Window {
         PuzzleRenderer *renderer;
         GuiRenderer *gui;
         PuzzleController *controller;
+        // Owned by the simulation, the renderer draws its own copy
         Puzzle *puzzle;
+        Puzzle *framePuzzle;
+        PuzzleSnapshot frame;
         double lastTime;
-        bool vsync;
+        double frameTime;
         bool fullscreen;
-        int maxFrames;
-        float updateBuffer;
+        bool guiHovered;
+        // Left presses that barely move select a cell instead of turning the camera
+        bool clickPending;
+        double pressX, pressY;
         static Window *current;
 };
 